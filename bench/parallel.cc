@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <print>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+
+
+template <typename F>
+static double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static uint64_t checksumItem(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+
+int main() {
+    const size_t nThreads = std::max(2u, std::thread::hardware_concurrency());
+    const size_t N = 50'000'000;
+
+    Scheduler scheduler {nThreads};
+    std::println("workers: {}, items: {}", nThreads, N);
+
+
+    /* -------- reduce -------- */
+
+    uint64_t serialSum = 0;
+    double serialMs = timeMs([&] {
+        for (size_t i = 0; i < N; i++)
+            serialSum += checksumItem(i);
+    });
+
+    uint64_t parallelSum = 0;
+    double parallelMs = timeMs([&] {
+        scheduler.runBlocking([&] () -> Promise<> {
+            parallelSum = co_await scheduler.parallelReduce(
+                0, N, uint64_t(0),
+                [] (size_t i) { return checksumItem(i); },
+                [] (uint64_t a, uint64_t b) { return a + b; }
+            );
+        });
+    });
+
+    std::println("checksum  serial: {:8.2f} ms   parallelReduce: {:8.2f} ms   speedup: {:.2f}x   (match: {})",
+        serialMs, parallelMs, serialMs / parallelMs, serialSum == parallelSum);
+
+
+    /* -------- for -------- */
+
+    std::vector<double> scores(N / 10);
+
+    serialMs = timeMs([&] {
+        for (size_t i = 0; i < scores.size(); i++)
+            scores[i] = std::sqrt(double(i)) * std::log1p(double(i));
+    });
+
+    parallelMs = timeMs([&] {
+        scheduler.runBlocking([&] () -> Promise<> {
+            co_await scheduler.parallelFor(0, scores.size(), [&scores] (size_t i) {
+                scores[i] = std::sqrt(double(i)) * std::log1p(double(i));
+            });
+        });
+    });
+
+    std::println("scoring   serial: {:8.2f} ms   parallelFor:    {:8.2f} ms   speedup: {:.2f}x",
+        serialMs, parallelMs, serialMs / parallelMs);
+
+
+    /* -------- sort -------- */
+
+    std::vector<uint32_t> data(N / 5);
+    std::mt19937 rng(42);
+    for (auto& x : data)
+        x = rng();
+
+    auto copy = data;
+
+    serialMs = timeMs([&] { std::sort(copy.begin(), copy.end()); });
+
+    parallelMs = timeMs([&] {
+        scheduler.runBlocking([&] () -> Promise<> {
+            co_await scheduler.parallelSort(data.begin(), data.end());
+        });
+    });
+
+    std::println("sort      serial: {:8.2f} ms   parallelSort:   {:8.2f} ms   speedup: {:.2f}x   (match: {})",
+        serialMs, parallelMs, serialMs / parallelMs, copy == data);
+
+    return 0;
+}
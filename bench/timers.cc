@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+// Lateness of Scheduler::delay, with and without precise timer mode.
+// Fails if a precise timer's median lateness reaches PRECISE_P50_BOUND.
+
+#include <algorithm>
+#include <chrono>
+#include <print>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+static double percentile(std::vector<double>& sorted, double p) {
+    size_t i = std::min(sorted.size() - 1, (size_t) (p * sorted.size()));
+    return sorted[i];
+}
+
+
+static const double PRECISE_P50_BOUND = 100;  // us
+
+
+/**
+ * @return False if precise timers missed PRECISE_P50_BOUND.
+ */
+static bool measure(bool precise, size_t nWorkers) {
+    const int N_SAMPLES = 300;
+    const nanoseconds DELAYS[] = { microseconds(20), microseconds(100), microseconds(500), milliseconds(2) };
+
+    Scheduler scheduler {nWorkers};
+    scheduler.setPreciseTimers(precise);
+
+    bool withinBound = true;
+
+    std::println("precise: {}, workers: {}", precise, nWorkers);
+    std::println("  {:>8}  {:>9}  {:>9}  {:>9}  {:>9}", "delay", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)");
+
+    for (auto d : DELAYS) {
+        std::vector<double> lateness;
+        lateness.reserve(N_SAMPLES);
+
+        scheduler.runBlocking([&] () -> Promise<> {
+            for (int i = 0; i < N_SAMPLES; i++) {
+                auto due = steady_clock::now() + d;
+                co_await scheduler.delay(d);
+                lateness.push_back(duration<double, std::micro>(steady_clock::now() - due).count());
+            }
+        });
+
+        std::sort(lateness.begin(), lateness.end());
+        double p50 = percentile(lateness, 0.5);
+        bool late = precise && p50 >= PRECISE_P50_BOUND;
+        withinBound = withinBound && !late;
+
+        std::println(
+            "  {:>6}us  {:>9.1f}  {:>9.1f}  {:>9.1f}  {:>9.1f}{}",
+            duration_cast<microseconds>(d).count(),
+            p50, percentile(lateness, 0.9), percentile(lateness, 0.99), lateness.back(),
+            late ? "  (p50 over bound)" : ""
+        );
+    }
+
+    return withinBound;
+}
+
+
+int main() {
+    bool ok = true;
+    ok = measure(false, 0) && ok;
+    ok = measure(true, 0) && ok;
+    ok = measure(false, 4) && ok;
+    ok = measure(true, 4) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/AsyncCache.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+// Test 1: Concurrent calls for one key share a single call
+Promise<> testSingleFlight() {
+    std::println("Test 1: SingleFlight...");
+
+    SingleFlight<std::string, int> flights;
+    int calls = 0;
+
+    auto load = [&calls] () -> Promise<int> {
+        calls++;
+        co_await Scheduler::getCurrent().delay(milliseconds(5));
+        co_return 42;
+    };
+
+    std::vector<Promise<int>> waiters;
+    for (int i = 0; i < 100; i++)
+        waiters.push_back(flights.run("key", load));
+
+    auto results = co_await promiseAll(std::move(waiters));
+    for (int x : results)
+        assert(x == 42);
+
+    assert(calls == 1);
+    assert(flights.calls() == 1);
+    assert(flights.coalesced() == 99);
+
+    // Once finished, the next call runs again.
+    assert(co_await flights.run("key", load) == 42);
+    assert(calls == 2);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: Failures reach every waiter, and aren't remembered
+Promise<> testSingleFlightError() {
+    std::println("Test 2: SingleFlight errors...");
+
+    SingleFlight<int, int> flights;
+
+    auto fail = [] () -> Promise<int> {
+        co_await Scheduler::getCurrent().delay(milliseconds(1));
+        throw std::runtime_error("backend down");
+    };
+
+    auto a = flights.run(1, fail);
+    auto b = flights.run(1, fail);
+
+    int failures = 0;
+    for (auto* p : { &a, &b }) {
+        try {
+            co_await *p;
+        }
+        catch (const std::runtime_error&) {
+            failures++;
+        }
+    }
+    assert(failures == 2);
+
+    assert(co_await flights.run(1, [] { return Promise<int>::resolve(7); }) == 7);
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Hits, misses and TTL expiry
+Promise<> testCacheTtl() {
+    std::println("Test 3: AsyncCache TTL...");
+
+    int loads = 0;
+    AsyncCache<int, std::string> cache(
+        [&loads] (const int& key) -> Promise<std::string> {
+            loads++;
+            co_await Scheduler::getCurrent().delay(milliseconds(1));
+            co_return std::to_string(key);
+        },
+        milliseconds(30),
+        1
+    );
+
+    assert(co_await cache.get(1) == "1");
+    assert(co_await cache.get(1) == "1");
+    assert(loads == 1);
+    assert(cache.size() == 1);
+
+    // Concurrent misses on a cold key load it once.
+    std::vector<Promise<std::string>> waiters;
+    for (int i = 0; i < 10; i++)
+        waiters.push_back(cache.get(2));
+    co_await promiseAll(std::move(waiters));
+    assert(loads == 2);
+
+    // Expired entries are misses. Reloading one sweeps the other out of the (single) shard.
+    co_await Scheduler::getCurrent().delay(milliseconds(60));
+    assert(cache.size() == 2);
+
+    assert(co_await cache.get(1) == "1");
+    assert(loads == 3);
+    assert(cache.size() == 1);
+
+    auto stats = cache.stats();
+    assert(stats.hits == 1);
+    assert(stats.misses == 12);
+    assert(stats.coalesced == 9);
+
+    cache.put(5, "five");
+    assert(co_await cache.get(5) == "five");
+    cache.invalidate(5);
+    assert(co_await cache.get(5) == "5");
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testSingleFlight();
+    co_await testSingleFlightError();
+    co_await testCacheTtl();
+
+    // Entries have no timers: this long TTL must not hold runBlocking.
+    AsyncCache<int, int> cache([] (const int& key) { return Promise<int>::resolve(key * 2); }, hours(1));
+    assert(co_await cache.get(21) == 42);
+}
+
+
+int main() {
+    auto start = steady_clock::now();
+    Scheduler::getDefault().runBlocking(runAllTests);
+    assert(steady_clock::now() - start < seconds(5));
+    return 0;
+}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <string>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/AsyncGenerator.h>
+
+using namespace vega;
+
+
+static int produced = 0;
+
+
+AsyncGenerator<int> numbers(int n) {
+    for (int i = 0; i < n; i++) {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+        produced++;
+        co_yield i;
+    }
+}
+
+
+AsyncGenerator<std::string> immediate() {
+    std::string s = "a";
+    co_yield s;          // lvalue
+    co_yield "b";        // temporary
+}
+
+
+AsyncGenerator<int> throwsAfter(int n) {
+    for (int i = 0; i < n; i++)
+        co_yield i;
+    throw std::runtime_error("generator");
+}
+
+
+// Test 1: Values arrive in order, with co_await inside the generator
+Promise<> testBasic() {
+    std::println("Test 1: basic iteration...");
+
+    auto gen = numbers(5);
+    int expected = 0;
+    while (auto x = co_await gen.next())
+        assert(*x == expected++);
+
+    assert(expected == 5);
+    assert(gen.done());
+    assert(!(co_await gen.next()).has_value());
+
+    auto strings = immediate();
+    assert(*co_await strings.next() == "a");
+    assert(*co_await strings.next() == "b");
+    assert(!co_await strings.next());
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: The producer only runs when pulled
+Promise<> testBackpressure() {
+    std::println("Test 2: lazy start and backpressure...");
+
+    produced = 0;
+    auto gen = numbers(100);
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+    assert(produced == 0);
+
+    co_await gen.next();
+    co_await gen.next();
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+    assert(produced == 2);
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Exceptions reach the consumer
+Promise<> testThrows() {
+    std::println("Test 3: exceptions...");
+
+    auto gen = throwsAfter(2);
+    assert(*co_await gen.next() == 0);
+    assert(*co_await gen.next() == 1);
+
+    bool caught = false;
+    try {
+        co_await gen.next();
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "generator");
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: Long synchronous streams don't grow the stack
+Promise<> testLongStream() {
+    std::println("Test 4: long synchronous stream...");
+
+    auto gen = [] () -> AsyncGenerator<long> {
+        for (long i = 0; i < 1000000; i++)
+            co_yield i;
+    } ();
+
+    long sum = 0;
+    while (auto x = co_await gen.next())
+        sum += *x;
+    assert(sum == 1000000L * 999999 / 2);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testBasic();
+    co_await testBackpressure();
+    co_await testThrows();
+    co_await testLongStream();
+
+    // Abandoned generators are destroyed at their co_yield.
+    auto gen = numbers(10);
+    co_await gen.next();
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testBasic);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/Batcher.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+/**
+ * Batch function squaring its keys, remembering batch sizes.
+ */
+auto squares(std::vector<size_t>& sizes) {
+    return [&sizes] (std::vector<int> keys) -> Promise<std::vector<int>> {
+        sizes.push_back(keys.size());
+        co_await Scheduler::getCurrent().delay(milliseconds(1));
+
+        std::vector<int> values;
+        for (int k : keys)
+            values.push_back(k * k);
+        co_return values;
+    };
+}
+
+
+// Test 1: Loads made in the same tick go in one batch
+Promise<> testSameTick() {
+    std::println("Test 1: Same tick...");
+
+    std::vector<size_t> sizes;
+    Batcher<int, int> batcher(squares(sizes));
+
+    std::vector<Promise<int>> loads;
+    for (int i = 0; i < 10; i++)
+        loads.push_back(batcher.load(i));
+
+    auto values = co_await promiseAll(std::move(loads));
+    for (int i = 0; i < 10; i++)
+        assert(values[i] == i * i);
+
+    assert(sizes == std::vector<size_t>{10});
+    assert(batcher.batches() == 1);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: A window collects loads across ticks
+Promise<> testWindow() {
+    std::println("Test 2: Window...");
+
+    std::vector<size_t> sizes;
+    Batcher<int, int> batcher(squares(sizes), { .window = milliseconds(30) });
+
+    std::vector<Promise<int>> loads;
+    for (int i = 0; i < 5; i++) {
+        loads.push_back(batcher.load(i));
+        co_await Scheduler::getCurrent().delay(milliseconds(1));
+    }
+
+    co_await promiseAll(std::move(loads));
+    assert(sizes == std::vector<size_t>{5});
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: maxBatchSize splits batches
+Promise<> testMaxBatchSize() {
+    std::println("Test 3: maxBatchSize...");
+
+    std::vector<size_t> sizes;
+    Batcher<int, int> batcher(squares(sizes), { .maxBatchSize = 4, .window = seconds(10) });
+
+    std::vector<Promise<int>> loads;
+    for (int i = 0; i < 10; i++)
+        loads.push_back(batcher.load(i));
+
+    // The last two wait for the window; flush sends them right away.
+    batcher.flush();
+
+    auto values = co_await promiseAll(std::move(loads));
+    assert(values[9] == 81);
+    assert((sizes == std::vector<size_t>{4, 4, 2}));
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: Failures reach every load of the batch
+Promise<> testErrors() {
+    std::println("Test 4: Errors...");
+
+    Batcher<int, int> failing([] (std::vector<int>) -> Promise<std::vector<int>> {
+        throw std::runtime_error("backend down");
+    });
+
+    Batcher<int, int> short_([] (std::vector<int>) {
+        return Promise<std::vector<int>>::resolve(std::vector<int>{1});
+    });
+
+    std::vector<Promise<int>> loads;
+    loads.push_back(failing.load(1));
+    loads.push_back(failing.load(2));
+    loads.push_back(short_.load(1));
+    loads.push_back(short_.load(2));
+
+    int failures = 0;
+    for (auto& load : loads) {
+        try {
+            co_await load;
+        }
+        catch (const std::runtime_error&) {
+            failures++;
+        }
+        catch (const std::length_error&) {
+            failures++;
+        }
+    }
+    assert(failures == 4);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testSameTick();
+    co_await testWindow();
+    co_await testMaxBatchSize();
+    co_await testErrors();
+}
+
+
+/**
+ * Load 0..9 slowly, giving idle workers every chance to flush early.
+ */
+Promise<std::vector<int>> loadSlowly(Batcher<int, int>& batcher) {
+    std::vector<Promise<int>> loads;
+    for (int i = 0; i < 10; i++) {
+        loads.push_back(batcher.load(i));
+        std::this_thread::sleep_for(microseconds(200));
+    }
+
+    co_return co_await promiseAll(std::move(loads));
+}
+
+
+// Test 5: Same tick on worker threads
+Promise<> testSameTickOnWorkers() {
+    std::println("Test 5: Same tick on worker threads...");
+
+    std::vector<size_t> sizes;
+    Batcher<int, int> batcher(squares(sizes));
+
+    // From the thread running runBlocking...
+    co_await loadSlowly(batcher);
+
+    // ...and from a worker, where the delay resumes this coroutine.
+    co_await Scheduler::getCurrent().delay(milliseconds(1));
+    co_await loadSlowly(batcher);
+
+    assert((sizes == std::vector<size_t>{10, 10}));
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    auto start = steady_clock::now();
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testSameTickOnWorkers);
+
+    // Flushed batches cancel their window timers.
+    assert(steady_clock::now() - start < seconds(5));
+    return 0;
+}
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <print>
+#include <string>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/PromiseRace.h>
+#include <vega/Channel.h>
+
+using namespace vega;
+
+
+static std::atomic<size_t> nAllocations = 0;
+
+void* operator new(std::size_t size) {
+    nAllocations++;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+// Test 1: Fast path
+Promise<> testFastPath() {
+    std::println("Test 1: buffered send/recv...");
+
+    Channel<int> ch(4);
+    assert(ch.capacity() == 4);
+
+    size_t before = nAllocations;
+    co_await ch.send(1);
+    co_await ch.send(2);
+    assert(*co_await ch.recv() == 1);
+    assert(*co_await ch.recv() == 2);
+    assert(nAllocations == before);
+
+    assert(ch.trySend(3));
+    assert(ch.tryRecv() == 3);
+    assert(!ch.tryRecv());
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: Suspending on full and empty
+Promise<> testSuspend() {
+    std::println("Test 2: send suspends when full, recv when empty...");
+
+    Channel<std::string> ch(2);
+
+    auto consume = [&ch] () -> Promise<std::vector<std::string>> {
+        std::vector<std::string> got;
+        while (auto s = co_await ch.recv()) {
+            got.push_back(*s);
+            co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+        }
+        co_return got;
+    };
+
+    auto consumer = consume();
+
+    for (int i = 0; i < 20; i++)
+        co_await ch.send(std::to_string(i));
+
+    ch.close();
+
+    auto got = co_await consumer;
+    assert(got.size() == 20);
+    for (int i = 0; i < 20; i++)
+        assert(got[i] == std::to_string(i));
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Close semantics
+Promise<> testClose() {
+    std::println("Test 3: close...");
+
+    Channel<int> ch(2);
+    co_await ch.send(1);
+    co_await ch.send(2);
+
+    auto blocked = ch.send(3);
+    assert(!blocked.settled());
+
+    ch.close();
+
+    bool caught = false;
+    try {
+        co_await blocked;
+    } catch (const ChannelClosedError&) {
+        caught = true;
+    }
+    assert(caught);
+
+    caught = false;
+    try {
+        co_await ch.send(4);
+    } catch (const ChannelClosedError&) {
+        caught = true;
+    }
+    assert(caught);
+
+    // Buffered values drain, then nullopt.
+    assert(*co_await ch.recv() == 1);
+    assert(*co_await ch.recv() == 2);
+    assert(!co_await ch.recv());
+
+    // Parked receivers are woken by close.
+    Channel<int> empty(2);
+    auto waiting = empty.recv();
+    empty.close();
+    assert(!co_await waiting);
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: Batch receive
+Promise<> testBatch() {
+    std::println("Test 4: recvBatch...");
+
+    Channel<int> ch(16);
+    for (int i = 0; i < 10; i++)
+        co_await ch.send(i);
+
+    auto batch = co_await ch.recvBatch(4);
+    assert((batch == std::vector<int> {0, 1, 2, 3}));
+
+    batch = co_await ch.recvBatch(100);
+    assert(batch.size() == 6 && batch[5] == 9);
+
+    ch.close();
+    assert((co_await ch.recvBatch(4)).empty());
+
+    std::println("  PASSED");
+}
+
+
+// Test 5: recv losing a race against a timeout
+Promise<> testRecvTimeout() {
+    std::println("Test 5: recv against a timeout...");
+
+    Channel<int> ch(2);
+
+    auto result = co_await promiseRace(ch.recv(), Scheduler::getCurrent().delay(std::chrono::milliseconds(10)));
+    assert(result.index() == 1);
+
+    // The timed out recv is gone: the next value goes to the next recv.
+    co_await ch.send(42);
+    assert(*co_await ch.recv() == 42);
+
+    // Same for a send that times out on a full channel: its value is dropped.
+    co_await ch.send(1);
+    co_await ch.send(2);
+    co_await promiseRace(ch.send(3), Scheduler::getCurrent().delay(std::chrono::milliseconds(10)));
+
+    assert(*co_await ch.recv() == 1);
+    assert(*co_await ch.recv() == 2);
+    assert(!ch.tryRecv());
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testFastPath();
+    co_await testSuspend();
+    co_await testClose();
+    co_await testBatch();
+    co_await testRecvTimeout();
+}
+
+
+// Test 6: Many producers and consumers on worker threads
+Promise<> testMpmc() {
+    std::println("Test 6: MPMC on worker threads...");
+
+    constexpr int nProducers = 4;
+    constexpr int nConsumers = 4;
+    constexpr long perProducer = 20000;
+
+    Channel<long> ch(64);
+    std::atomic<long> sum = 0;
+    std::atomic<long> count = 0;
+
+    auto producer = [&ch] (int id) -> Promise<> {
+        for (long i = 0; i < perProducer; i++)
+            co_await ch.send(id * perProducer + i);
+    };
+
+    auto consumer = [&ch, &sum, &count] () -> Promise<> {
+        while (auto x = co_await ch.recv()) {
+            sum += *x;
+            count++;
+        }
+    };
+
+    std::vector<Promise<>> producers;
+    std::vector<Promise<>> consumers;
+    for (int i = 0; i < nConsumers; i++)
+        consumers.push_back(consumer());
+    for (int i = 0; i < nProducers; i++)
+        producers.push_back(producer(i));
+
+    co_await promiseAll(std::move(producers));
+    ch.close();
+    co_await promiseAll(std::move(consumers));
+
+    long n = nProducers * perProducer;
+    assert(count == n);
+    assert(sum == n * (n - 1) / 2);
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testMpmc);
+    return 0;
+}
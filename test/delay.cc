@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: MulanPSL-2.0
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include <vega/Scheduler.h>
 #include <vega/Promise.h>
@@ -33,5 +35,21 @@ int main() {
         co_return;
     });
 
+    // Precise timers: sub-millisecond delays never fire early.
+    // (How late they are depends on the machine: see bench/timers.cc.)
+    vega::Scheduler precise;
+    precise.setPreciseTimers(true);
+
+    std::vector<std::chrono::steady_clock::duration> lateness;
+    precise.runBlocking([&] () -> vega::Promise<void> {
+        for (int i = 0; i < 100; i++) {
+            auto due = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+            co_await precise.delay(std::chrono::microseconds(50));
+            lateness.push_back(std::chrono::steady_clock::now() - due);
+        }
+    });
+
+    assert(*std::min_element(lateness.begin(), lateness.end()) >= std::chrono::microseconds(0));
+
     return 0;
 }
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <vega/vega.h>
+#include <vega/PromiseAll.h>
+
+#include "nop.h"
+
+
+using namespace vega;
+
+
+Promise<> testFanOut() {
+    std::println("=== fan-out is submitted at once ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+    size_t before = ring.submits();
+
+    std::vector<Promise<int32_t>> nops;
+    for (int i = 0; i < 64; i++)
+        nops.push_back(nop());
+
+    // Nothing is submitted until the scheduler's loop comes around.
+    assert(ring.submits() == before);
+    assert(io_uring_sq_ready(&ring.ring()) == 64);
+
+    auto results = co_await promiseAll(nops);
+    for (auto res : results)
+        assert(res == 0);
+
+    std::println("submits: {}", ring.submits() - before);
+    assert(ring.submits() - before == 1);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testFullQueue() {
+    std::println("=== full submission queue is submitted to make room ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+    size_t before = ring.submits();
+
+    std::vector<Promise<int32_t>> nops;
+    for (int i = 0; i < 100; i++)
+        nops.push_back(nop());
+
+    // The ring has 8 SQEs: they went out in 8-SQE batches while the rest were queued up.
+    assert(ring.submits() - before == 100 / 8);
+
+    auto results = co_await promiseAll(nops);
+    for (auto res : results)
+        assert(res == 0);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testFlush() {
+    std::println("=== explicit flush ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+    size_t before = ring.submits();
+
+    io_uring_sqe* sqe = co_await ring.getSqe();
+    io_uring_prep_nop(sqe);
+    auto result = ring.submitAndWaitRes(sqe);
+
+    ring.flush();
+    assert(ring.submits() == before + 1);
+    assert(io_uring_sq_ready(&ring.ring()) == 0);
+
+    // Flushing with nothing queued is free.
+    ring.flush();
+    assert(ring.submits() == before + 1);
+
+    assert(co_await result == 0);
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.runBlocking([] () -> Promise<> {
+            co_await testFanOut();
+            co_await testFlush();
+        });
+    }).join();
+
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig({ .sqEntries = 8 });
+        scheduler.runBlocking(testFullQueue);
+    }).join();
+
+    return 0;
+}
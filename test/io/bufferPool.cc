@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vega/vega.h>
+#include <vega/PromiseAll.h>
+
+
+using namespace vega;
+
+const char* TEST_FILE_PATH = "./__test_buffer_pool_tmp.txt";
+
+
+Promise<> testLeases() {
+    std::println("=== leases ===");
+
+    io::BufferPool pool(4096, 2);
+    assert(pool.available() == 2);
+
+    auto a = pool.tryLease();
+    auto b = pool.tryLease();
+    assert(a && b && a->size() == 4096);
+    assert(a->data() != b->data());
+    assert(!pool.tryLease());
+
+    // Waits until a buffer is given back.
+    auto waiting = pool.lease();
+    assert(waiting.state->status == PromiseStatus::Pending);
+
+    char* data = a->data();
+    a->release();
+
+    auto c = co_await waiting;
+    assert(c.data() == data);
+    assert(pool.available() == 0);
+
+    b.reset();
+    assert(pool.available() == 1);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testFile() {
+    std::println("=== file I/O with leased buffers ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+    size_t registeredBefore = ring.registeredBuffers();
+
+    {
+        io::BufferPool pool(16 * 1024, 4, true);
+        std::println("registered: {}, huge pages: {}", pool.registered(), pool.hugePages());
+        if (pool.registered())
+            assert(ring.registeredBuffers() == registeredBefore + 1);
+
+        io::IoUringFile file;
+        assert(file.open(TEST_FILE_PATH, io::FileOpenMode::ReadWrite | io::FileOpenMode::Truncate));
+
+        auto out = co_await pool.lease();
+        for (size_t i = 0; i < out.size(); i++)
+            out.data()[i] = char('a' + i % 26);
+
+        assert(co_await file.write(out, out.size(), 0) == out.size());
+
+        auto in = co_await pool.lease();
+        assert(co_await file.read(in, in.size(), 0) == in.size());
+        assert(std::memcmp(in.data(), out.data(), in.size()) == 0);
+
+        // Part of the buffer, at an offset.
+        std::memset(in.data(), 0, in.size());
+        assert(co_await file.read(in, 26, 26) == 26);
+        assert(std::memcmp(in.data(), out.data(), 26) == 0);
+
+        bool threw = false;
+        try {
+            co_await file.read(in, in.size() + 1, 0);
+        } catch (const std::length_error&) {
+            threw = true;
+        }
+        assert(threw);
+
+        // Another thread's ring doesn't know the pool: plain reads there.
+        std::thread([&] () {
+            Scheduler scheduler;
+            scheduler.runBlocking([&] () -> Promise<> {
+                std::memset(in.data(), 0, in.size());
+                assert(co_await file.read(in, in.size(), 0) == in.size());
+                assert(std::memcmp(in.data(), out.data(), in.size()) == 0);
+            });
+        }).join();
+
+        file.close();
+    }
+
+    assert(ring.registeredBuffers() == registeredBefore);
+    std::remove(TEST_FILE_PATH);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testSocket() {
+    std::println("=== socket I/O with leased buffers ===");
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(listener, (sockaddr*) &addr, sizeof(addr)) == 0);
+    assert(::listen(listener, 1) == 0);
+
+    socklen_t len = sizeof(addr);
+    assert(::getsockname(listener, (sockaddr*) &addr, &len) == 0);
+
+    io::IoUringInet4StreamSocket socket;
+    co_await socket.connect({ "127.0.0.1", ntohs(addr.sin_port) });
+    int peer = ::accept(listener, nullptr, nullptr);
+
+    io::BufferPool pool(1024, 1);
+    auto buffer = co_await pool.lease();
+
+    std::memcpy(buffer.data(), "ping", 4);
+    assert(co_await socket.writeSome(buffer, 4) == 4);
+
+    char raw[4];
+    assert(::read(peer, raw, 4) == 4);
+    assert(std::memcmp(raw, "ping", 4) == 0);
+
+    assert(::write(peer, "pong", 4) == 4);
+    assert(co_await socket.readSome(buffer, buffer.size()) == 4);
+    assert(std::memcmp(buffer.data(), "pong", 4) == 0);
+
+    ::close(peer);
+    socket.close();
+    ::close(listener);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> leaseLoop(io::BufferPool& pool) {
+    for (int i = 0; i < 200; i++) {
+        auto buffer = co_await pool.lease();
+        buffer.data()[0] = char(i);
+
+        if (i % 10 == 0)
+            co_await Scheduler::getCurrent().delay(std::chrono::microseconds(50));
+    }
+}
+
+
+void testWorkers() {
+    std::println("=== leases on worker threads ===");
+
+    std::thread([] () {
+        Scheduler scheduler {4};
+        io::BufferPool pool(256, 4);
+
+        scheduler.runBlocking([&pool] () -> Promise<> {
+            std::vector<Promise<>> tasks;
+            for (int i = 0; i < 32; i++)
+                tasks.push_back(leaseLoop(pool));
+
+            co_await promiseAll(std::move(tasks));
+            assert(pool.available() == 4);
+        });
+    }).join();
+
+    std::println("[PASS]");
+}
+
+
+void testTableFull() {
+    std::println("=== full buffer table ===");
+
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig({ .fixedBuffers = 1 });
+
+        scheduler.runBlocking([] () -> Promise<> {
+            io::BufferPool a(4096, 1);
+            io::BufferPool b(4096, 1);
+
+            // b couldn't get a slot, and does plain I/O.
+            if (a.registered())
+                assert(!b.registered());
+
+            co_return;
+        });
+    }).join();
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.runBlocking([] () -> Promise<> {
+            co_await testLeases();
+            co_await testFile();
+            co_await testSocket();
+        });
+    }).join();
+
+    testWorkers();
+    testTableFull();
+    return 0;
+}
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vega/vega.h>
+
+
+using namespace vega;
+
+const char* TEST_FILE_PATH = "./__test_fixed_files_tmp.txt";
+
+
+Promise<> roundTrip(io::IoUringFile& file, const std::string& text) {
+    io::File& f = file;
+    assert(co_await f.write(text.data(), text.size(), 0) == text.size());
+
+    std::vector<char> buf(text.size());
+    assert(co_await f.read(buf, 0) == text.size());
+    assert(std::string(buf.begin(), buf.end()) == text);
+}
+
+
+Promise<> testRegistered() {
+    std::println("=== registered file ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+
+    io::IoUringFile file;
+    assert(file.open(TEST_FILE_PATH, io::FileOpenMode::ReadWrite | io::FileOpenMode::Truncate));
+    if (!file.registerFd()) {
+        std::println("no registered file table here: skipping");
+        co_return;
+    }
+
+    assert(ring.registeredFiles() == 1);
+    assert(file.registerFd());  // already registered.
+    co_await roundTrip(file, "registered");
+
+    file.close();
+    assert(ring.registeredFiles() == 0);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testDirect() {
+    std::println("=== direct descriptor ===");
+
+    auto& ring = io::IoUring::getThreadIoUring();
+
+    io::IoUringFile file;
+    if (!co_await file.openDirect(TEST_FILE_PATH, io::FileOpenMode::ReadWrite | io::FileOpenMode::Truncate)) {
+        std::println("no direct descriptors here: skipping");
+        co_return;
+    }
+
+    assert(file.isOpen());
+    assert(file.fd() == -1);
+    assert(ring.registeredFiles() == 1);
+    co_await roundTrip(file, "direct");
+
+    // Another thread's ring has no idea what the slot is.
+    std::thread([&] () {
+        Scheduler scheduler;
+        scheduler.runBlocking([&] () -> Promise<> {
+            bool threw = false;
+            try {
+                char c;
+                co_await file.tryRead(&c, 1, 0);
+            } catch (const std::logic_error&) {
+                threw = true;
+            }
+            assert(threw);
+        });
+    }).join();
+
+    file.close();
+    assert(ring.registeredFiles() == 0);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testSocket() {
+    std::println("=== direct and registered sockets ===");
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(listener, (sockaddr*) &addr, sizeof(addr)) == 0);
+    assert(::listen(listener, 4) == 0);
+
+    socklen_t len = sizeof(addr);
+    assert(::getsockname(listener, (sockaddr*) &addr, &len) == 0);
+    io::Inet4Address remote { "127.0.0.1", ntohs(addr.sin_port) };
+
+    char buf[8] = {};
+
+    // Direct: writes through the slot.
+    io::IoUringInet4StreamSocket direct;
+    bool connected = true;
+    try {
+        co_await direct.connectDirect(remote);
+    } catch (const io::SocketError&) {
+        connected = false;
+        std::println("no direct sockets here: skipping");
+    }
+
+    if (connected) {
+        assert(direct.fd() == -1);
+        int peer = ::accept(listener, nullptr, nullptr);
+        assert(co_await direct.writeSome("direct", 6) == 6);
+        assert(::read(peer, buf, sizeof(buf)) == 6);
+        assert(std::string(buf, 6) == "direct");
+        ::close(peer);
+        direct.close();
+    }
+
+    // Registered: reads through the slot.
+    io::IoUringInet4StreamSocket socket;
+    co_await socket.connect(remote);
+    bool registered = socket.registerFd();
+
+    int peer = ::accept(listener, nullptr, nullptr);
+    assert(::write(peer, "plain", 5) == 5);
+    assert(co_await socket.readSome(buf, 5) == 5);
+    assert(std::string(buf, 5) == "plain");
+
+    ::close(peer);
+    socket.close();
+    ::close(listener);
+
+    if (registered)
+        assert(io::IoUring::getThreadIoUring().registeredFiles() == 0);
+
+    std::println("[PASS]");
+}
+
+
+void testTableFull() {
+    std::println("=== full file table ===");
+
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig({ .fixedFiles = 1 });
+
+        scheduler.runBlocking([] () -> Promise<> {
+            io::IoUringFile a, b;
+            assert(a.open(TEST_FILE_PATH, io::FileOpenMode::ReadWrite | io::FileOpenMode::Truncate));
+            assert(b.open(TEST_FILE_PATH, io::FileOpenMode::ReadWrite));
+
+            if (!a.registerFd())
+                co_return;
+
+            // No slot left: b keeps working through its fd.
+            assert(!b.registerFd());
+            co_await roundTrip(b, "unregistered");
+
+            a.close();
+            assert(b.registerFd());
+            co_await roundTrip(b, "registered");
+        });
+    }).join();
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.runBlocking([] () -> Promise<> {
+            co_await testRegistered();
+            co_await testDirect();
+            co_await testSocket();
+        });
+    }).join();
+
+    testTableFull();
+
+    std::remove(TEST_FILE_PATH);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <variant>
+#include <vector>
+
+#include <print>
+
+#include <sys/stat.h>
+
+#include <vega/vega.h>
+#include <vega/PromiseRace.h>
+
+
+using namespace vega;
+
+const char* TEST_FIFO_PATH = "./__test_io_cancel_fifo";
+
+
+Promise<> testRaceCancelsRead() {
+    std::println("=== promiseRace cancels in-flight io_uring read ===");
+
+    std::remove(TEST_FIFO_PATH);
+    assert(mkfifo(TEST_FIFO_PATH, 0644) == 0);
+
+    // Opened read-write, so open doesn't block. Nobody writes, so reads never complete.
+    io::IoUringFile _file;
+    io::File& file = _file;
+    assert(file.open(TEST_FIFO_PATH, io::FileOpenMode::ReadWrite));
+
+    std::vector<char> buf(16, 0);
+
+    bool readCancelled = false;
+    auto reader = [&] () -> Promise<size_t> {
+        try {
+            co_return co_await file.read(buf, 0);
+        } catch (const CancelledError&) {
+            readCancelled = true;
+            throw;
+        }
+    };
+
+    auto result = co_await promiseRace(reader(), Scheduler::getCurrent().delay(std::chrono::milliseconds(20)));
+    assert(result.index() == 1);
+
+    // The read resolves with -ECANCELED once the kernel processes the cancellation.
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(20));
+    assert(readCancelled);
+
+    // tryRead reports the cancellation as an error code.
+    auto tryReader = file.tryRead(buf, 0);
+    tryReader.state->cancel();
+    auto readResult = co_await tryReader.catchError([] (std::exception_ptr) -> io::IoResult<> {
+        return io::errnoError(ECANCELED);
+    });
+    assert(!readResult.has_value());
+    assert(readResult.error().value() == ECANCELED);
+
+    file.close();
+    std::remove(TEST_FIFO_PATH);
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    auto start = std::chrono::steady_clock::now();
+    Scheduler::getDefault().runBlocking(testRaceCancelsRead);
+
+    // No in-flight read may keep runBlocking waiting.
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    return 0;
+}
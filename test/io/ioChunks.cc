@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <print>
+
+#include <vega/vega.h>
+
+
+using namespace vega;
+
+const char* TEST_FILE_PATH = "./__test_io_chunks_tmp.txt";
+
+
+Promise<> testReadChunks() {
+    std::println("=== readChunks on IoUringFile ===");
+
+    std::string content;
+    for (int i = 0; i < 1000; i++)
+        content += std::to_string(i) + ",";
+
+    io::IoUringFile _file;
+    io::File& file = _file;
+    assert(file.open(TEST_FILE_PATH, io::FileOpenMode::ReadWrite | io::FileOpenMode::Truncate));
+    co_await file.write(content.data(), content.size(), 0);
+
+    std::string streamed;
+    size_t nChunks = 0;
+
+    auto chunks = file.readChunks(256);
+    while (auto chunk = co_await chunks.next()) {
+        assert(chunk->size() <= 256);
+        streamed.append(chunk->begin(), chunk->end());
+        nChunks++;
+    }
+
+    assert(streamed == content);
+    assert(nChunks == (content.size() + 255) / 256);
+    std::println("  {} bytes in {} chunks", streamed.size(), nChunks);
+
+    // Starting from an offset.
+    auto tail = file.readChunks(4096, long(content.size()) - 4);
+    auto last = co_await tail.next();
+    assert(std::string(last->begin(), last->end()) == "999,");
+    assert(!co_await tail.next());
+
+    file.close();
+    std::println("[PASS]");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(testReadChunks);
+    std::remove(TEST_FILE_PATH);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <unistd.h>
+
+#include <vega/vega.h>
+#include <vega/PromiseAll.h>
+
+
+using namespace vega;
+
+
+/**
+ * A NOP through [IoUring::operation], which waits in line when the ring has no free SQE.
+ */
+Promise<int32_t> operationNop() {
+    auto cqe = co_await io::IoUring::getThreadIoUring().operation([] (io_uring_sqe* sqe) {
+        io_uring_prep_nop(sqe);
+    });
+    co_return cqe.res;
+}
+
+
+Promise<> testMoreThanSqSize() {
+    std::println("=== more operations than SQEs ===");
+
+    // The ring has 8 SQEs: the rest wait in line for them.
+    std::vector<Promise<int32_t>> nops;
+    for (int i = 0; i < 100; i++)
+        nops.push_back(operationNop());
+
+    auto results = co_await promiseAll(nops);
+    for (auto res : results)
+        assert(res == 0);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testTimeout(int fd) {
+    std::println("=== linked timeout ===");
+
+    char c;
+    auto start = std::chrono::steady_clock::now();
+    auto cqe = co_await io::IoUring::getThreadIoUring().operation([&] (io_uring_sqe* sqe) {
+        io_uring_prep_read(sqe, fd, &c, 1, 0);
+    }, std::chrono::milliseconds(20));
+
+    assert(cqe.res == -ETIMEDOUT);
+    assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testCancel(int fd) {
+    std::println("=== cancelling the awaiting coroutine ===");
+
+    bool cancelled = false;
+    auto reader = [&] () -> Promise<> {
+        char c;
+        try {
+            co_await io::IoUring::getThreadIoUring().operation([&] (io_uring_sqe* sqe) {
+                io_uring_prep_read(sqe, fd, &c, 1, 0);
+            });
+        } catch (const CancelledError&) {
+            cancelled = true;
+            throw;
+        }
+    };
+
+    auto read = reader();
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(5));
+    read.state->cancel();
+
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(20));
+    assert(cancelled);
+
+    // Cancelled before it even starts.
+    auto early = reader();
+    early.state->cancel();
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(5));
+
+    std::println("[PASS]");
+}
+
+
+Promise<> readOne(int fd, char* c, bool* done) {
+    auto cqe = co_await io::IoUring::getThreadIoUring().operation([&] (io_uring_sqe* sqe) {
+        io_uring_prep_read(sqe, fd, c, 1, 0);
+    });
+    assert(cqe.res == 1);
+    *done = true;
+}
+
+
+void testDrainWaits() {
+    std::println("=== runBlocking waits for operations nobody awaits ===");
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    char c = 0;
+    bool done = false;
+
+    std::thread writer([fd = fds[1]] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        assert(write(fd, "x", 1) == 1);
+    });
+
+    std::thread([&] () {
+        Scheduler scheduler;
+        scheduler.runBlocking([&] () -> Promise<> {
+            // Dropped right away: only the operation itself keeps the scheduler running.
+            readOne(fds[0], &c, &done);
+
+            co_return;
+        });
+    }).join();
+
+    writer.join();
+    assert(done && c == 'x');
+
+    close(fds[0]);
+    close(fds[1]);
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig({ .sqEntries = 8 });
+
+        scheduler.runBlocking([] () -> Promise<> {
+            // Nobody writes: reads only end by timeout or cancellation.
+            int fds[2];
+            assert(pipe(fds) == 0);
+
+            co_await testMoreThanSqSize();
+            co_await testTimeout(fds[0]);
+            co_await testCancel(fds[0]);
+
+            close(fds[0]);
+            close(fds[1]);
+        });
+    }).join();
+
+    testDrainWaits();
+    return 0;
+}
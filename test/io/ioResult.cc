@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <print>
+
+#include <vega/vega.h>
+
+
+using namespace vega;
+
+const char* TEST_FILE_PATH = "./__test_io_result_tmp.txt";
+
+
+Promise<> testFileErrors() {
+    std::println("=== tryRead/tryWrite on IoUringFile ===");
+
+    io::IoUringFile _file;
+    io::File& file = _file;
+    assert(file.open(TEST_FILE_PATH, io::FileOpenMode::Write | io::FileOpenMode::Truncate));
+
+    std::vector<char> buf { 'v', 'e', 'g', 'a' };
+    auto written = co_await file.tryWrite(buf);
+    assert(written.has_value());
+    assert(*written == buf.size());
+
+    // File is closed, reading should fail without throwing.
+    file.close();
+    auto readResult = co_await file.tryRead(buf, 0);
+    assert(!readResult.has_value());
+    assert(readResult.error().value() == EBADF);
+    std::println("  tryRead error: {}", readResult.error().message());
+
+    // The throwing API still throws.
+    bool thrown = false;
+    try {
+        co_await file.read(buf, 0);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testStreamFile() {
+    std::println("=== tryRead on StreamFile ===");
+
+    io::StreamFile _file;
+    io::File& file = _file;
+    assert(file.open(TEST_FILE_PATH, io::FileOpenMode::Read));
+
+    std::vector<char> buf(4, 0);
+    auto readResult = co_await file.tryRead(buf, 0);
+    assert(readResult.has_value());
+    assert(*readResult == 4);
+    assert(std::string(buf.begin(), buf.end()) == "vega");
+
+    std::println("[PASS]");
+}
+
+
+Promise<> testSocketErrors() {
+    std::println("=== tryReadSome/tryWriteSome on IoUringInet4StreamSocket ===");
+
+    io::IoUringInet4StreamSocket sock;  // not connected.
+    std::vector<char> buf(16, 0);
+
+    auto readResult = co_await sock.tryReadSome(buf.data(), buf.size());
+    assert(!readResult.has_value());
+    assert(readResult.error().value() == EBADF);
+
+    auto writeResult = co_await sock.tryWriteSome(buf.data(), buf.size());
+    assert(!writeResult.has_value());
+    assert(writeResult.error().value() == EBADF);
+
+    bool thrown = false;
+    try {
+        co_await sock.readSome(buf.data(), buf.size());
+    }
+    catch (const io::SocketError&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::println("[PASS]");
+}
+
+
+Promise<> blockingMain() {
+    co_await testFileErrors();
+    co_await testStreamFile();
+    co_await testSocketErrors();
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(blockingMain);
+    std::remove(TEST_FILE_PATH);
+    return 0;
+}
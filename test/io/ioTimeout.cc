@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#include <print>
+
+#include <sys/stat.h>
+
+#include <vega/vega.h>
+
+
+using namespace vega;
+using namespace std::chrono;
+
+const char* TEST_FIFO_PATH = "./__test_io_timeout_fifo";
+
+
+Promise<> testLinkedTimeout() {
+    std::println("=== io_uring linked timeouts ===");
+
+    std::remove(TEST_FIFO_PATH);
+    assert(mkfifo(TEST_FIFO_PATH, 0644) == 0);
+
+    // Opened read-write, so open doesn't block. Reads only complete once we write.
+    io::IoUringFile file;
+    assert(file.open(TEST_FIFO_PATH, io::FileOpenMode::ReadWrite));
+
+    std::vector<char> buf(16, 0);
+
+    // Nothing to read: the kernel aborts the read after the deadline.
+    auto start = steady_clock::now();
+    bool timedOut = false;
+    try {
+        co_await file.read(buf.data(), buf.size(), 0, milliseconds(20));
+    }
+    catch (const io::TimeoutError&) {
+        timedOut = true;
+    }
+    assert(timedOut);
+    assert(steady_clock::now() - start >= milliseconds(15));
+    assert(steady_clock::now() - start < seconds(2));
+
+    auto result = co_await file.tryRead(buf.data(), buf.size(), 0, milliseconds(10));
+    assert(!result.has_value());
+    assert(result.error() == std::errc::timed_out);
+
+    // Completing before the deadline isn't affected by it.
+    const char* msg = "hello";
+    co_await file.write(msg, std::strlen(msg), 0, seconds(5));
+
+    auto n = co_await file.read(buf.data(), buf.size(), 0, seconds(5));
+    assert(n == std::strlen(msg));
+    assert(std::memcmp(buf.data(), msg, n) == 0);
+
+    file.close();
+    std::remove(TEST_FIFO_PATH);
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(testLinkedTimeout);
+    return 0;
+}
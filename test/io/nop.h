@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <cstdint>
+
+#include <vega/vega.h>
+
+
+/**
+ * Submit a NOP on the calling thread's ring, and get its result.
+ */
+inline vega::Promise<int32_t> nop() {
+    auto& ring = vega::io::IoUring::getThreadIoUring();
+    io_uring_sqe* sqe = co_await ring.getSqe();
+    io_uring_prep_nop(sqe);
+    co_return co_await ring.submitAndWaitRes(sqe);
+}
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <vega/vega.h>
+#include <vega/PromiseAll.h>
+
+#include "nop.h"
+
+
+using namespace vega;
+
+
+/**
+ * Run [concurrency] NOPs at once, then one more after an idle spell, on the calling thread's ring.
+ */
+Promise<> exercise(size_t concurrency) {
+    std::vector<Promise<int32_t>> nops;
+    for (size_t i = 0; i < concurrency; i++)
+        nops.push_back(nop());
+
+    auto results = co_await promiseAll(nops);
+    for (auto res : results)
+        assert(res == 0);
+
+    // A submission made after the thread has been idle.
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(5));
+
+    assert(co_await nop() == 0);
+}
+
+
+/**
+ * Run [exercise] on a fresh thread (so it gets a fresh ring) with [config], and get the ring's setup flags.
+ */
+unsigned runWith(const io::RingConfig& config, size_t concurrency, unsigned* sqEntries = nullptr, unsigned* cqEntries = nullptr) {
+    unsigned flags = 0;
+
+    std::thread([&] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig(config);
+
+        scheduler.runBlocking([&] () -> Promise<> {
+            auto& ring = io::IoUring::getThreadIoUring();
+            flags = ring.setupFlags();
+            if (sqEntries)
+                *sqEntries = ring.sqEntries();
+            if (cqEntries)
+                *cqEntries = ring.cqEntries();
+
+            co_await exercise(concurrency);
+        });
+    }).join();
+
+    return flags;
+}
+
+
+void testDefault() {
+    std::println("=== default config ===");
+
+    unsigned sqEntries, cqEntries;
+    unsigned flags = runWith({}, 1000, &sqEntries, &cqEntries);
+
+    assert(sqEntries == io::IO_URING_QUEUE_DEPTH);
+    assert(cqEntries >= sqEntries);
+    assert(!(flags & IORING_SETUP_DEFER_TASKRUN));
+    std::println("flags: {:#x}", flags);
+
+    std::println("[PASS]");
+}
+
+
+void testSizes() {
+    std::println("=== queue sizes ===");
+
+    unsigned sqEntries, cqEntries;
+    unsigned flags = runWith({ .sqEntries = 8, .cqEntries = 64 }, 100, &sqEntries, &cqEntries);
+
+    assert(sqEntries == 8);
+    if (flags & IORING_SETUP_CQSIZE)
+        assert(cqEntries == 64);
+
+    std::println("[PASS]");
+}
+
+
+void testDeferTaskrun() {
+    std::println("=== deferred task running ===");
+
+    unsigned flags = runWith({ .deferTaskrun = true }, 1000);
+
+    // DEFER_TASKRUN is only kept together with SINGLE_ISSUER.
+    if (flags & IORING_SETUP_DEFER_TASKRUN)
+        assert(flags & IORING_SETUP_SINGLE_ISSUER);
+    std::println("flags: {:#x}", flags);
+
+    std::println("[PASS]");
+}
+
+
+void testPlain() {
+    std::println("=== no optional flags ===");
+
+    io::RingConfig config {
+        .singleIssuer = false,
+        .coopTaskrun = false,
+        .registerRingFd = false,
+    };
+    unsigned flags = runWith(config, 100);
+
+    assert(flags == 0);
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    testDefault();
+    testSizes();
+    testDeferTaskrun();
+    testPlain();
+    return 0;
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <print>
+
+#include <vega/vega.h>
+#include <vega/PromiseAll.h>
+
+#include "nop.h"
+
+
+using namespace vega;
+
+Promise<> testSubmission() {
+    std::println("=== I/O through the polling thread ===");
+
+    unsigned flags = io::IoUring::getThreadIoUring().setupFlags();
+    if (!(flags & IORING_SETUP_SQPOLL))
+        std::println("SQPOLL not available here: testing the fallback");
+
+    std::vector<Promise<int32_t>> nops;
+    for (int i = 0; i < 1000; i++)
+        nops.push_back(nop());
+
+    auto results = co_await promiseAll(nops);
+    for (auto res : results)
+        assert(res == 0);
+
+    // Let the polling thread go idle, so the next submission has to wake it up.
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(30));
+
+    assert(co_await nop() == 0);
+
+    std::println("[PASS]");
+}
+
+
+void testSharedPoller() {
+    std::println("=== worker rings share one polling thread ===");
+
+    Scheduler scheduler {2};
+    scheduler.setRingConfig({ .sqpoll = true, .sqpollIdle = std::chrono::milliseconds(10) });
+
+    std::mutex lock;
+    std::vector<std::pair<std::thread::id, unsigned>> rings;
+
+    scheduler.runBlocking([&] () -> Promise<> {
+        co_await scheduler.parallelFor(0, 2, [&] (size_t) {
+            unsigned flags = io::IoUring::getThreadIoUring().setupFlags();
+            {
+                std::lock_guard _l {lock};
+                rings.emplace_back(std::this_thread::get_id(), flags);
+            }
+
+            // Keep this worker busy, so the other one takes the other index.
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }, 1);
+    });
+
+    assert(rings.size() == 2);
+    assert(rings[0].first != rings[1].first);
+
+    for (auto [_, flags] : rings) {
+        if (flags & IORING_SETUP_SQPOLL)
+            assert(flags & IORING_SETUP_ATTACH_WQ);
+    }
+
+    std::println("[PASS]");
+}
+
+
+int main() {
+    std::thread([] () {
+        Scheduler scheduler;
+        scheduler.setRingConfig({ .sqpoll = true, .sqpollIdle = std::chrono::milliseconds(10) });
+        scheduler.runBlocking(testSubmission);
+    }).join();
+
+    testSharedPoller();
+    return 0;
+}
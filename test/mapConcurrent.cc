@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/MapConcurrent.h>
+
+using namespace vega;
+
+
+static std::atomic<size_t> active = 0;
+static std::atomic<size_t> maxActive = 0;
+
+
+static Promise<int> work(int x) {
+    size_t now = ++active;
+    size_t prev = maxActive.load();
+    while (now > prev && !maxActive.compare_exchange_weak(prev, now));
+
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(x % 3));
+
+    active--;
+    co_return x * 2;
+}
+
+
+// Test 1: Results in input order, bounded concurrency
+Promise<> testOrdered() {
+    std::println("Test 1: ordered results with bounded concurrency...");
+
+    maxActive = 0;
+    auto results = co_await mapConcurrent(std::views::iota(0, 10000), 16, work);
+
+    assert(results.size() == 10000);
+    for (int i = 0; i < 10000; i++)
+        assert(results[i] == i * 2);
+
+    assert(maxActive <= 16);
+    assert(maxActive > 1);
+
+    std::println("  PASSED: max in flight = {}", maxActive.load());
+}
+
+
+// Test 2: Streaming results with backpressure from the sink
+Promise<> testSink() {
+    std::println("Test 2: streaming results to a sink...");
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 100; i++)
+        names.push_back(std::to_string(i));
+
+    size_t received = 0;
+    size_t sum = 0;
+
+    co_await mapConcurrent(names, 4, [] (std::string name) { return name.size(); }, [&] (size_t, size_t len) -> Promise<> {
+        received++;
+        sum += len;
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(0));
+    });
+
+    assert(received == 100);
+    assert(sum == 10 + 90 * 2);
+    assert(names.size() == 100 && names[99] == "99");  // lvalue ranges are copied from.
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Failures stop taking new items
+Promise<> testFailure() {
+    std::println("Test 3: first failure rejects...");
+
+    size_t started = 0;
+    bool caught = false;
+
+    try {
+        co_await mapConcurrent(std::views::iota(0, 1000), 2, [&started] (int x) -> Promise<int> {
+            started++;
+            co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+            if (x == 10)
+                throw std::runtime_error("item 10");
+            co_return x;
+        });
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "item 10");
+    }
+
+    assert(caught);
+    assert(started < 20);
+
+    std::println("  PASSED: {} items started", started);
+}
+
+
+// Test 4: Void results
+Promise<> testVoid() {
+    std::println("Test 4: void results...");
+
+    std::atomic<int> count = 0;
+    co_await mapConcurrent(std::vector<int>(50, 1), 8, [&count] (int x) -> Promise<> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+        count += x;
+    });
+
+    assert(count == 50);
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testOrdered();
+    co_await testSink();
+    co_await testFailure();
+    co_await testVoid();
+}
+
+
+Promise<> testOnWorkers() {
+    std::println("Test 5: ordered results on worker threads...");
+
+    maxActive = 0;
+    auto results = co_await mapConcurrent(std::views::iota(0, 2000), 8, work);
+    for (int i = 0; i < 2000; i++)
+        assert(results[i] == i * 2);
+    assert(maxActive <= 8);
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testOnWorkers);
+    return 0;
+}
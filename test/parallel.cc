@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <print>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+
+
+Promise<> testParallelFor() {
+    std::println("Test 1: parallelFor...");
+
+    auto& scheduler = Scheduler::getCurrent();
+
+    std::vector<int> data(100000, 0);
+    co_await scheduler.parallelFor(0, data.size(), [&data] (size_t i) { data[i] = int(i) * 2; });
+
+    for (size_t i = 0; i < data.size(); i++)
+        assert(data[i] == int(i) * 2);
+
+    // Empty range and explicit grain.
+    co_await scheduler.parallelFor(5, 5, [] (size_t) { assert(false); });
+
+    std::atomic<size_t> count = 0;
+    co_await scheduler.parallelFor(0, 1000, [&count] (size_t) { count++; }, 7);
+    assert(count == 1000);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> testParallelReduce() {
+    std::println("Test 2: parallelReduce...");
+
+    auto& scheduler = Scheduler::getCurrent();
+
+    uint64_t sum = co_await scheduler.parallelReduce(
+        0, 1000000, uint64_t(0),
+        [] (size_t i) { return uint64_t(i); },
+        [] (uint64_t a, uint64_t b) { return a + b; }
+    );
+    assert(sum == uint64_t(1000000) * 999999 / 2);
+
+    // Not commutative: partial results must be combined in order.
+    std::string joined = co_await scheduler.parallelReduce(
+        0, 200, std::string(),
+        [] (size_t i) { return std::string(1, char('a' + i % 26)); },
+        [] (std::string a, std::string b) { return a + b; },
+        3
+    );
+    for (size_t i = 0; i < 200; i++)
+        assert(joined[i] == char('a' + i % 26));
+
+    std::println("  PASSED");
+}
+
+
+Promise<> testParallelTransformAndSort() {
+    std::println("Test 3: parallelTransform and parallelSort...");
+
+    auto& scheduler = Scheduler::getCurrent();
+
+    std::vector<int> in(50000);
+    std::mt19937 rng(42);
+    for (auto& x : in)
+        x = int(rng() % 1000000);
+
+    std::vector<int> out(in.size());
+    co_await scheduler.parallelTransform(in.begin(), in.end(), out.begin(), [] (int x) { return -x; });
+    for (size_t i = 0; i < in.size(); i++)
+        assert(out[i] == -in[i]);
+
+    auto expected = in;
+    std::sort(expected.begin(), expected.end());
+    co_await scheduler.parallelSort(in.begin(), in.end());
+    assert(in == expected);
+
+    co_await scheduler.parallelSort(out.begin(), out.end(), std::greater<> {});
+    assert(std::is_sorted(out.begin(), out.end(), std::greater<> {}));
+
+    std::println("  PASSED");
+}
+
+
+Promise<> testParallelThrows() {
+    std::println("Test 4: exceptions propagate...");
+
+    bool caught = false;
+    try {
+        co_await Scheduler::getCurrent().parallelFor(0, 10000, [] (size_t i) {
+            if (i == 4321)
+                throw std::runtime_error("4321");
+        });
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "4321");
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testParallelFor();
+    co_await testParallelReduce();
+    co_await testParallelTransformAndSort();
+    co_await testParallelThrows();
+}
+
+
+int main() {
+    std::println("--- Single threaded scheduler ---");
+    Scheduler::getDefault().runBlocking(runAllTests);
+
+    std::println("--- Scheduler with 4 workers ---");
+    Scheduler{4}.runBlocking(runAllTests);
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include <cassert>
 #include <chrono>
 #include <print>
+#include <string>
+#include <variant>
+#include <vector>
 
 #include <vega/Scheduler.h>
 #include <vega/Promise.h>
@@ -208,6 +211,158 @@ Promise<> testMixedCallablesWithPromises() {
 }
 
 
+// Test 11: Promise.all over a vector of promises
+Promise<> testRange() {
+    std::println("Test 11: promiseAll over std::vector<Promise<int>>...");
+
+    auto makeDelayedPromise = [](int value, int delayMs) -> Promise<int> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(delayMs));
+        co_return value;
+    };
+
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < 10; i++) {
+        if (i % 2)
+            promises.push_back(Promise<int>::resolve(i));
+        else
+            promises.push_back(makeDelayedPromise(i, 50 - i * 5));
+    }
+
+    auto result = co_await promiseAll(promises);
+
+    assert(result.size() == 10);
+    for (int i = 0; i < 10; i++)
+        assert(result[i] == i);
+
+    std::vector<Promise<int>> empty;
+    auto emptyResult = co_await promiseAll(empty);
+    assert(emptyResult.empty());
+
+    std::println("  PASSED: Got vector [0..9] in input order");
+}
+
+
+// Test 12: Promise.all over a range of Promise<void>, with rejection
+Promise<> testRangeVoidAndRejection() {
+    std::println("Test 12: promiseAll over Promise<void> range and rejection...");
+
+    std::vector<Promise<>> delays;
+    for (int i = 0; i < 5; i++)
+        delays.push_back(Scheduler::getCurrent().delay(std::chrono::milliseconds(10 * i)));
+
+    co_await promiseAll(std::move(delays));
+
+    std::vector<Promise<int>> promises;
+    promises.push_back(Promise<int>::resolve(1));
+    promises.push_back(Promise<int>::reject(std::runtime_error("Range error")));
+    promises.push_back(Promise<int>());  // never settles.
+
+    bool caught = false;
+    try {
+        co_await promiseAll(promises);
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "Range error");
+    }
+
+    assert(caught);
+    std::println("  PASSED: Void range resolved, rejection propagated");
+}
+
+
+// Test 13: Large fan-out
+Promise<> testLargeFanOut() {
+    std::println("Test 13: promiseAll over 10000 promises...");
+
+    auto shard = [](int i) -> Promise<int> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(i % 20));
+        co_return i;
+    };
+
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < 10000; i++)
+        promises.push_back(shard(i));
+
+    auto result = co_await promiseAll(promises);
+    for (int i = 0; i < 10000; i++)
+        assert(result[i] == i);
+
+    std::println("  PASSED");
+}
+
+
+// Test 14: Heterogeneous promiseAllTuple
+Promise<> testTuple() {
+    std::println("Test 14: promiseAllTuple with heterogeneous types...");
+
+    struct NoDefault {
+        int x;
+        explicit NoDefault(int x) : x(x) {}
+    };
+
+    auto delayedString = []() -> Promise<std::string> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(20));
+        co_return "vega";
+    };
+
+    auto delayedNoDefault = []() -> Promise<NoDefault> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+        co_return NoDefault(3);
+    };
+
+    auto [i, d, str, v, nd] = co_await promiseAllTuple(
+        Promise<int>::resolve(1),
+        []() { return 2.5; },
+        delayedString(),
+        Scheduler::getCurrent().delay(std::chrono::milliseconds(5)),
+        delayedNoDefault
+    );
+
+    static_assert(std::is_same_v<decltype(v), std::monostate>);
+    assert(i == 1);
+    assert(d == 2.5);
+    assert(str == "vega");
+    assert(nd.x == 3);
+
+    auto empty = co_await promiseAllTuple();
+    static_assert(std::tuple_size_v<decltype(empty)> == 0);
+
+    bool caught = false;
+    try {
+        co_await promiseAllTuple(
+            delayedString(),
+            Promise<int>::reject(std::runtime_error("Tuple error"))
+        );
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "Tuple error");
+    }
+
+    assert(caught);
+    std::println("  PASSED: Got (1, 2.5, \"vega\", monostate, NoDefault{3})");
+}
+
+
+Promise<> testRangeOnWorkers() {
+    std::println("Test 15: promiseAll over promises settled on worker threads...");
+
+    auto task = [](int i) -> Promise<int> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(0));
+        co_return i * 2;
+    };
+
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < 1000; i++)
+        promises.push_back(task(i));
+
+    auto result = co_await promiseAll(promises);
+    for (int i = 0; i < 1000; i++)
+        assert(result[i] == i * 2);
+
+    std::println("  PASSED");
+}
+
+
 Promise<> runAllTests() {
     std::println("Running Promise.all tests...\n");
     
@@ -221,6 +376,10 @@ Promise<> runAllTests() {
     co_await testEmpty();
     co_await testVoidPromises();
     co_await testMixedCallablesWithPromises();
+    co_await testRange();
+    co_await testRangeVoidAndRejection();
+    co_await testLargeFanOut();
+    co_await testTuple();
     
     std::println("\nAll tests passed!");
 }
@@ -228,6 +387,7 @@ Promise<> runAllTests() {
 
 int main() {
     Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testRangeOnWorkers);
     return 0;
 }
 
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseRace.h>
+
+using namespace vega;
+
+
+static Promise<int> delayed(int value, int ms) {
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(ms));
+    co_return value;
+}
+
+
+static Promise<int> delayedThrow(int ms) {
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(ms));
+    throw std::runtime_error("delayedThrow");
+}
+
+
+// Test 1: The first promise to settle wins
+Promise<> testRace() {
+    std::println("Test 1: promiseRace picks the first to settle...");
+
+    int value = co_await promiseRace(delayed(1, 50), delayed(2, 10), delayed(3, 30));
+    assert(value == 2);
+
+    bool caught = false;
+    try {
+        co_await promiseRace(delayed(1, 50), delayedThrow(10));
+    } catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "delayedThrow");
+    }
+    assert(caught);
+
+    // Already settled inputs win right away.
+    value = co_await promiseRace(delayed(1, 10), 7);
+    assert(value == 7);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: Losers are cancelled
+Promise<> testLosersCancelled() {
+    std::println("Test 2: losers are cancelled...");
+
+    bool loserFinished = false;
+    bool loserCancelled = false;
+
+    auto loser = [&] () -> Promise<int> {
+        try {
+            co_await Scheduler::getCurrent().delay(std::chrono::seconds(10));
+            loserFinished = true;
+        } catch (const CancelledError&) {
+            loserCancelled = true;
+            throw;
+        }
+        co_return 0;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    int value = co_await promiseRace(loser(), delayed(5, 10));
+    assert(value == 5);
+    assert(loserCancelled);
+    assert(!loserFinished);
+
+    // The cancelled 10s delay must not keep the scheduler busy.
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    assert(elapsed < std::chrono::seconds(1));
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: promiseAny skips rejections
+Promise<> testAny() {
+    std::println("Test 3: promiseAny...");
+
+    int value = co_await promiseAny(delayedThrow(5), delayed(2, 20), delayed(3, 40));
+    assert(value == 2);
+
+    bool caught = false;
+    try {
+        co_await promiseAny(delayedThrow(5), delayedThrow(10));
+    } catch (const AggregateError& e) {
+        caught = true;
+        assert(e.errors.size() == 2);
+        assert(e.errors[0] && e.errors[1]);
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: Heterogeneous inputs resolve to a variant
+Promise<> testHeterogeneous() {
+    std::println("Test 4: heterogeneous promiseRace...");
+
+    auto str = [] () -> Promise<std::string> {
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+        co_return "vega";
+    };
+
+    auto result = co_await promiseRace(delayed(1, 50), str(), Scheduler::getCurrent().delay(std::chrono::milliseconds(30)));
+    static_assert(std::is_same_v<decltype(result), std::variant<int, std::string, std::monostate>>);
+    assert(result.index() == 1);
+    assert(std::get<1>(result) == "vega");
+
+    // Timeout style race.
+    auto timeout = co_await promiseRace(delayed(1, 1000), Scheduler::getCurrent().delay(std::chrono::milliseconds(10)));
+    assert(timeout.index() == 1);
+
+    std::println("  PASSED");
+}
+
+
+// Test 5: Ranges
+Promise<> testRange() {
+    std::println("Test 5: promiseRace / promiseAny over ranges...");
+
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < 10; i++)
+        promises.push_back(delayed(i, 100 - i * 5));
+
+    assert(co_await promiseRace(promises) == 9);
+
+    std::vector<Promise<int>> mixed;
+    mixed.push_back(delayedThrow(5));
+    mixed.push_back(delayed(42, 20));
+    assert(co_await promiseAny(std::move(mixed)) == 42);
+
+    std::vector<Promise<int>> empty;
+    bool caught = false;
+    try {
+        co_await promiseAny(empty);
+    } catch (const AggregateError& e) {
+        caught = true;
+        assert(e.errors.empty());
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+// Test 6: Cancelling the race itself
+Promise<> testCancelRace() {
+    std::println("Test 6: cancelling a race cancels its inputs...");
+
+    auto race = promiseRace(
+        Scheduler::getCurrent().delay(std::chrono::seconds(10)),
+        Scheduler::getCurrent().delay(std::chrono::seconds(10))
+    );
+
+    race.state->cancel();
+
+    bool caught = false;
+    try {
+        co_await race;
+    } catch (const CancelledError&) {
+        caught = true;
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testRace();
+    co_await testLosersCancelled();
+    co_await testAny();
+    co_await testHeterogeneous();
+    co_await testRange();
+    co_await testCancelRace();
+    std::println("\nAll tests passed!");
+}
+
+
+int main() {
+    auto start = std::chrono::steady_clock::now();
+    Scheduler::getDefault().runBlocking(runAllTests);
+
+    // No cancelled timer may keep runBlocking waiting.
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    return 0;
+}
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <print>
+#include <stdexcept>
+#include <string>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+
+
+static size_t nAllocations = 0;
+
+void* operator new(std::size_t size) {
+    nAllocations++;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+static Promise<int> delayed(int value) {
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+    co_return value;
+}
+
+
+static Promise<int> delayedThrow() {
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+    throw std::runtime_error("delayedThrow");
+}
+
+
+Promise<> testMapReady() {
+    std::println("Test 1: map on fulfilled promise...");
+
+    size_t before = nAllocations;
+    auto doubled = Promise<int>::resolve(21).map([] (int x) { return x * 2; });
+    assert(nAllocations == before);
+
+    assert(co_await doubled == 42);
+    std::println("  PASSED");
+}
+
+
+Promise<> testMapPending() {
+    std::println("Test 2: map on pending promise...");
+
+    Promise<int> source;
+    size_t before = nAllocations;
+    auto mapped = source.map([] (int x) { return std::to_string(x); });
+    assert(nAllocations - before == 1);
+
+    source.state->resolve(7);
+    assert(co_await mapped == "7");
+
+    assert(co_await delayed(5).map([] (int x) { return x + 1; }) == 6);
+    std::println("  PASSED");
+}
+
+
+Promise<> testThen() {
+    std::println("Test 3: then flattens promises...");
+
+    int value = co_await delayed(1).then([] (int x) { return delayed(x + 10); });
+    assert(value == 11);
+
+    value = co_await Promise<int>::resolve(2).then([] (int x) { return delayed(x * 100); });
+    assert(value == 200);
+
+    bool called = false;
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1)).then([&called] () {
+        called = true;
+        return delayed(0);
+    });
+    assert(called);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> testErrors() {
+    std::println("Test 4: rejections and catchError...");
+
+    bool mapCalled = false;
+    auto rejected = delayedThrow().map([&mapCalled] (int x) { mapCalled = true; return x; });
+
+    bool caught = false;
+    try {
+        co_await rejected;
+    }
+    catch (const std::runtime_error& e) {
+        caught = true;
+        assert(std::string(e.what()) == "delayedThrow");
+    }
+    assert(caught);
+    assert(!mapCalled);
+
+    int recovered = co_await delayedThrow().catchError([] (std::exception_ptr) { return -1; });
+    assert(recovered == -1);
+
+    int passed = co_await delayed(3).catchError([] (std::exception_ptr) { return -1; });
+    assert(passed == 3);
+
+    // Exceptions thrown by callbacks reject the returned promise.
+    caught = false;
+    try {
+        co_await delayed(4).map([] (int) -> int { throw std::logic_error("map"); });
+    }
+    catch (const std::logic_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testMapReady();
+    co_await testMapPending();
+    co_await testThen();
+    co_await testErrors();
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    return 0;
+}
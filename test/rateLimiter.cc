@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <print>
+#include <stdexcept>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/RateLimiter.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+// Test 1: Bursts up to the bucket size, then paces at the rate
+Promise<> testPacing() {
+    std::println("Test 1: Burst and pacing...");
+
+    AsyncRateLimiter limiter(1000, 10);
+
+    for (int i = 0; i < 10; i++)
+        assert(limiter.tryAcquire());
+    assert(!limiter.tryAcquire());
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < 50; i++)
+        co_await limiter.acquire();
+
+    // 50 tokens at 1000/s.
+    auto elapsed = steady_clock::now() - start;
+    assert(elapsed >= milliseconds(40));
+    assert(elapsed < seconds(2));
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: Many waiters are served in FIFO order
+Promise<> testManyWaiters() {
+    std::println("Test 2: Many waiters...");
+
+    AsyncRateLimiter limiter(200000, 100);
+    std::vector<int> order;
+
+    std::vector<Promise<void>> waiters;
+    for (int i = 0; i < 20000; i++)
+        waiters.push_back(limiter.acquire().map([&order, i] () { order.push_back(i); }));
+
+    assert(limiter.waiting() > 0);
+    co_await promiseAll(std::move(waiters));
+
+    assert(order.size() == 20000);
+    for (int i = 0; i < 20000; i++)
+        assert(order[i] == i);
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Cancelled waiters leave the queue, oversize requests fail
+Promise<> testCancelAndInvalid() {
+    std::println("Test 3: Cancel and invalid requests...");
+
+    AsyncRateLimiter limiter(100, 1);
+    assert(limiter.tryAcquire());
+
+    auto first = limiter.acquire();
+    auto second = limiter.acquire();
+    first.state->cancel();
+
+    bool cancelled = false;
+    try {
+        co_await first;
+    }
+    catch (const CancelledError&) {
+        cancelled = true;
+    }
+    assert(cancelled);
+
+    // `second` takes the token `first` would have had.
+    auto start = steady_clock::now();
+    co_await second;
+    assert(steady_clock::now() - start < milliseconds(50));
+
+    bool rejected = false;
+    try {
+        co_await limiter.acquire(2);
+    }
+    catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: Destroying the limiter rejects its waiters
+Promise<> testDestroy() {
+    std::println("Test 4: Destroyed with waiters...");
+
+    auto limiter = std::make_unique<AsyncRateLimiter>(1, 1);
+    assert(limiter->tryAcquire());
+
+    auto waiting = limiter->acquire();
+    limiter.reset();
+
+    bool cancelled = false;
+    try {
+        co_await waiting;
+    }
+    catch (const CancelledError&) {
+        cancelled = true;
+    }
+    assert(cancelled);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testPacing();
+    co_await testManyWaiters();
+    co_await testCancelAndInvalid();
+    co_await testDestroy();
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    return 0;
+}
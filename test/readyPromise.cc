@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+
+
+static size_t nAllocations = 0;
+
+void* operator new(std::size_t size) {
+    nAllocations++;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+Promise<> suspendMain() {
+    size_t before = nAllocations;
+
+    int value = co_await Promise<int>::resolve(42);
+    co_await Promise<>::resolve();
+
+    auto p = Promise<long>::resolve(7);
+    assert(p.settled());
+    assert(p.state == nullptr);
+    long longValue = co_await p;
+
+    assert(nAllocations == before);
+    assert(value == 42);
+    assert(longValue == 7);
+
+    // Materializing a shared state keeps the value.
+    auto str = Promise<std::string>::resolve(std::string("vega"));
+    auto state = str.getState();
+    assert(state->status == PromiseStatus::Fulfilled);
+    assert(co_await str == "vega");
+
+    // Pending promises still suspend.
+    auto pending = Scheduler::getCurrent().delay(std::chrono::milliseconds(10));
+    assert(!pending.settled());
+    co_await pending;
+    assert(pending.settled());
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(suspendMain);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+// Test 1: Ticks follow absolute deadlines until cancelled
+Promise<> testTicks() {
+    std::println("Test 1: Ticks and cancel...");
+
+    auto& scheduler = Scheduler::getCurrent();
+    const auto period = milliseconds(10);
+
+    auto start = steady_clock::now();
+    std::vector<steady_clock::time_point> ticks;
+
+    auto interval = scheduler.setInterval([&ticks] () {
+        ticks.push_back(steady_clock::now());
+    }, period);
+
+    co_await scheduler.delay(milliseconds(105));
+    interval.state->cancel();
+
+    bool cancelled = false;
+    try {
+        co_await interval;
+    }
+    catch (const CancelledError&) {
+        cancelled = true;
+    }
+    assert(cancelled);
+
+    std::println("  {} ticks", ticks.size());
+    assert(ticks.size() >= 8 && ticks.size() <= 10);
+
+    // Lateness doesn't add up: tick k runs shortly after start + k * period.
+    for (size_t k = 0; k < ticks.size(); k++) {
+        auto lateness = ticks[k] - (start + (k + 1) * period);
+        assert(lateness >= microseconds(0));
+        assert(lateness < milliseconds(8));
+    }
+
+    // No more ticks after cancelling.
+    size_t count = ticks.size();
+    co_await scheduler.delay(milliseconds(30));
+    assert(ticks.size() == count);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: A throwing callback stops the interval
+Promise<> testThrow() {
+    std::println("Test 2: Throwing callback...");
+
+    int calls = 0;
+    auto interval = Scheduler::getCurrent().setInterval([&calls] () {
+        if (++calls == 3)
+            throw std::runtime_error("stop");
+    }, milliseconds(1));
+
+    bool caught = false;
+    try {
+        co_await interval;
+    }
+    catch (const std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+    assert(calls == 3);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testTicks();
+    co_await testThrow();
+}
+
+
+int main() {
+    // Returns once the intervals are stopped: cancelled entries don't keep it busy.
+    Scheduler::getDefault().runBlocking(runAllTests);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/Strand.h>
+
+using namespace vega;
+
+
+// Test 1: Posts from one thread run in order
+Promise<> testPostOrder() {
+    std::println("Test 1: Post order...");
+
+    Strand strand(Scheduler::getCurrent());
+    std::vector<int> order;
+
+    for (int i = 0; i < 200; i++)
+        strand.post([&order, i] () { order.push_back(i); });
+
+    co_await strand.run([] () {});
+
+    assert(order.size() == 200);
+    for (int i = 0; i < 200; i++)
+        assert(order[i] == i);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: run() returns values and exceptions
+Promise<> testRun() {
+    std::println("Test 2: run...");
+
+    Strand strand(Scheduler::getCurrent());
+
+    int x = co_await strand.run([] () { return 42; });
+    assert(x == 42);
+
+    bool caught = false;
+    try {
+        co_await strand.run([] () -> int { throw std::runtime_error("boom"); });
+    }
+    catch (const std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testPostOrder();
+    co_await testRun();
+}
+
+
+// Test 3: Coroutines entering a strand on worker threads never overlap
+Promise<> testSerializedOnWorkers() {
+    std::println("Test 3: co_await strand on worker threads...");
+
+    Strand strand(Scheduler::getCurrent());
+    long counter = 0;  // only touched inside the strand.
+    std::atomic<int> inside = 0;
+
+    auto worker = [&] () -> Promise<> {
+        for (int i = 0; i < 1000; i++) {
+            co_await strand;
+            assert(strand.runningInThisThread());
+            assert(++inside == 1);
+            counter++;
+            inside--;
+
+            if (i % 100 == 0)
+                co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(0));
+        }
+    };
+
+    std::vector<Promise<>> workers;
+    for (int i = 0; i < 16; i++)
+        workers.push_back(worker());
+
+    co_await promiseAll(std::move(workers));
+
+    long total = co_await strand.run([&] () { return counter; });
+    assert(total == 16000);
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testSerializedOnWorkers);
+    return 0;
+}
@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <print>
+#include <vector>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+#include <vega/PromiseRace.h>
+#include <vega/Sync.h>
+
+using namespace vega;
+
+
+// Test 1: Mutual exclusion and FIFO handoff
+Promise<> testMutex() {
+    std::println("Test 1: AsyncMutex...");
+
+    AsyncMutex mutex;
+    int inside = 0;
+    std::vector<int> order;
+
+    auto worker = [&] (int id) -> Promise<> {
+        auto guard = co_await mutex.scopedLock();
+        assert(++inside == 1);
+        order.push_back(id);
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+        inside--;
+    };
+
+    std::vector<Promise<>> workers;
+    for (int i = 0; i < 20; i++)
+        workers.push_back(worker(i));
+
+    co_await promiseAll(std::move(workers));
+
+    for (int i = 0; i < 20; i++)
+        assert(order[i] == i);
+
+    assert(mutex.tryLock());
+    assert(!mutex.tryLock());
+    mutex.unlock();
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: Semaphore bounds concurrency
+Promise<> testSemaphore() {
+    std::println("Test 2: AsyncSemaphore...");
+
+    AsyncSemaphore semaphore(3);
+    int active = 0;
+    int maxActive = 0;
+
+    auto worker = [&] () -> Promise<> {
+        co_await semaphore.acquire();
+        maxActive = std::max(maxActive, ++active);
+        co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(2));
+        active--;
+        semaphore.release();
+    };
+
+    std::vector<Promise<>> workers;
+    for (int i = 0; i < 30; i++)
+        workers.push_back(worker());
+
+    co_await promiseAll(std::move(workers));
+
+    assert(maxActive == 3);
+    assert(semaphore.available() == 3);
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: Condition variable
+Promise<> testConditionVariable() {
+    std::println("Test 3: AsyncConditionVariable...");
+
+    AsyncMutex mutex;
+    AsyncConditionVariable cv;
+    std::deque<int> queue;
+    bool finished = false;
+    int sum = 0;
+
+    auto consumer = [&] () -> Promise<> {
+        co_await mutex.lock();
+        while (true) {
+            co_await cv.wait(mutex, [&] { return !queue.empty() || finished; });
+            if (queue.empty())
+                break;
+            sum += queue.front();
+            queue.pop_front();
+        }
+        mutex.unlock();
+    };
+
+    auto consumers = promiseAll(consumer(), consumer());
+
+    for (int i = 1; i <= 100; i++) {
+        auto guard = co_await mutex.scopedLock();
+        queue.push_back(i);
+        cv.notifyOne();
+        if (i % 10 == 0) {
+            guard.unlock();
+            co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+        }
+    }
+
+    {
+        auto guard = co_await mutex.scopedLock();
+        finished = true;
+        cv.notifyAll();
+    }
+
+    co_await consumers;
+    assert(sum == 5050);
+
+    std::println("  PASSED");
+}
+
+
+// Test 4: WaitGroup
+Promise<> testWaitGroup() {
+    std::println("Test 4: WaitGroup...");
+
+    WaitGroup wg;
+    co_await wg.wait();  // zero: returns right away.
+
+    int finished = 0;
+    wg.add(5);
+    for (int i = 0; i < 5; i++) {
+        Scheduler::getCurrent().setTimeout([&] { finished++; wg.done(); }, std::chrono::milliseconds(i * 2));
+    }
+
+    co_await wg.wait();
+    assert(finished == 5);
+    assert(wg.count() == 0);
+
+    std::println("  PASSED");
+}
+
+
+// Test 5: Cancelling waiters
+Promise<> testCancel() {
+    std::println("Test 5: cancelling waiters...");
+
+    AsyncMutex mutex;
+    co_await mutex.lock();
+
+    // A cancelled lock() leaves the queue, and unlocking doesn't hand the mutex to it.
+    auto waiting = mutex.lock();
+    waiting.state->cancel();
+    assert(waiting.state->status == PromiseStatus::Rejected);
+
+    co_await promiseRace(mutex.lock(), Scheduler::getCurrent().delay(std::chrono::milliseconds(5)));
+
+    mutex.unlock();
+    assert(mutex.tryLock());
+    assert(!mutex.tryLock());
+    mutex.unlock();
+
+    // A cancelled condition variable wait still locks the mutex again before it throws.
+    AsyncConditionVariable cv;
+    bool cancelled = false;
+
+    auto waiter = [&] () -> Promise<> {
+        auto guard = co_await mutex.scopedLock();
+        try {
+            co_await cv.wait(mutex);
+        }
+        catch (const CancelledError&) {
+            cancelled = true;
+            assert(!mutex.tryLock());
+            throw;
+        }
+    };
+
+    auto task = waiter();
+    co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(1));
+    task.state->cancel();
+
+    try {
+        co_await task;
+    }
+    catch (const CancelledError&) {}
+
+    assert(cancelled);
+    assert(mutex.tryLock());
+    assert(!mutex.tryLock());
+    mutex.unlock();
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testMutex();
+    co_await testSemaphore();
+    co_await testConditionVariable();
+    co_await testWaitGroup();
+    co_await testCancel();
+}
+
+
+// Test 6: Contended mutex across worker threads
+Promise<> testMutexOnWorkers() {
+    std::println("Test 6: AsyncMutex on worker threads...");
+
+    AsyncMutex mutex;
+    long counter = 0;  // protected by mutex only.
+    std::atomic<int> inside = 0;
+
+    auto worker = [&] () -> Promise<> {
+        for (int i = 0; i < 1000; i++) {
+            co_await mutex.lock();
+            assert(++inside == 1);
+            counter++;
+            inside--;
+            mutex.unlock();
+
+            if (i % 100 == 0)
+                co_await Scheduler::getCurrent().delay(std::chrono::milliseconds(0));
+        }
+    };
+
+    std::vector<Promise<>> workers;
+    for (int i = 0; i < 16; i++)
+        workers.push_back(worker());
+
+    co_await promiseAll(std::move(workers));
+    assert(counter == 16000);
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testMutexOnWorkers);
+    return 0;
+}
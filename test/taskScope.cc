@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <print>
+#include <stdexcept>
+
+#include <vega/Scheduler.h>
+#include <vega/Promise.h>
+#include <vega/TaskScope.h>
+
+using namespace vega;
+using namespace std::chrono;
+
+
+// Test 1: join waits for every child
+Promise<> testJoin() {
+    std::println("Test 1: join...");
+
+    TaskScope scope;
+    co_await scope.join();  // empty: returns right away.
+
+    int finished = 0;
+    for (int i = 0; i < 10; i++) {
+        scope.spawn([&finished, i] () -> Promise<> {
+            co_await Scheduler::getCurrent().delay(milliseconds(i));
+            finished++;
+        });
+    }
+    scope.spawn(Promise<int>::resolve(1));  // already done: not counted.
+
+    assert(scope.size() == 10);
+    co_await scope.join();
+    assert(finished == 10);
+    assert(scope.size() == 0);
+
+    std::println("  PASSED");
+}
+
+
+// Test 2: cancel stops suspended children right away
+Promise<> testCancel() {
+    std::println("Test 2: cancel...");
+
+    TaskScope scope;
+    int cancelled = 0;
+
+    for (int i = 0; i < 5; i++) {
+        scope.spawn([&cancelled] () -> Promise<> {
+            try {
+                co_await Scheduler::getCurrent().delay(seconds(10));
+            }
+            catch (const CancelledError&) {
+                cancelled++;
+                throw;
+            }
+        });
+    }
+
+    auto start = steady_clock::now();
+    co_await Scheduler::getCurrent().delay(milliseconds(5));
+    scope.cancel();
+    co_await scope.join();  // CancelledError isn't a failure.
+
+    assert(cancelled == 5);
+    assert(steady_clock::now() - start < seconds(1));
+
+    // Spawning into a cancelled scope doesn't start the child.
+    bool started = false;
+    scope.spawn([&started] () -> Promise<> { started = true; co_return; });
+    assert(!started);
+
+    std::println("  PASSED");
+}
+
+
+// Test 3: a failing child cancels its siblings and fails join
+Promise<> testFailure() {
+    std::println("Test 3: failure...");
+
+    TaskScope scope;
+    bool siblingCancelled = false;
+
+    scope.spawn([&siblingCancelled] () -> Promise<> {
+        try {
+            co_await Scheduler::getCurrent().delay(seconds(10));
+        }
+        catch (const CancelledError&) {
+            siblingCancelled = true;
+        }
+    });
+
+    scope.spawn([] () -> Promise<> {
+        co_await Scheduler::getCurrent().delay(milliseconds(2));
+        throw std::runtime_error("boom");
+    });
+
+    bool caught = false;
+    try {
+        co_await scope.join();
+    }
+    catch (const std::runtime_error& e) {
+        caught = std::string(e.what()) == "boom";
+    }
+
+    assert(caught);
+    assert(siblingCancelled);
+    assert(scope.cancelled());
+
+    std::println("  PASSED");
+}
+
+
+Promise<> runAllTests() {
+    co_await testJoin();
+    co_await testCancel();
+    co_await testFailure();
+}
+
+
+// Test 4: CPU-bound children on worker threads poll for cancellation
+Promise<> testCpuBoundOnWorkers() {
+    std::println("Test 4: throwIfCancelled on worker threads...");
+
+    TaskScope scope;
+    std::atomic<int> stopped = 0;
+
+    // Leave workers free for the rest, as spinning children hold theirs until cancelled.
+    for (int i = 0; i < 2; i++) {
+        scope.spawn([&scope, &stopped] () -> Promise<> {
+            co_await Scheduler::getCurrent().delay(milliseconds(0));
+            try {
+                while (true)
+                    scope.throwIfCancelled();
+            }
+            catch (const CancelledError&) {
+                stopped++;
+            }
+        });
+    }
+
+    co_await Scheduler::getCurrent().delay(milliseconds(10));
+    scope.cancel();
+    co_await scope.join();
+    assert(stopped == 2);
+
+    std::println("  PASSED");
+}
+
+
+int main() {
+    Scheduler::getDefault().runBlocking(runAllTests);
+    Scheduler{4}.runBlocking(testCpuBoundOnWorkers);
+    return 0;
+}
@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <vega/Promise.h>
+#include <vega/Scheduler.h>
+
+
+/**
+ * namespace vega::__cache_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace vega::__cache_details {
+
+
+/**
+ * Promise that settles like [flight], with a copy of its value. Every caller waiting for the
+ * same flight gets its own, so one caller's co_await (which moves the value out) or
+ * cancellation doesn't affect the others.
+ */
+template <typename V>
+Promise<V> follow(const std::shared_ptr<PromiseState<V>>& flight) {
+    if (flight->status == PromiseStatus::Fulfilled)
+        return Promise<V>::resolve(*flight->value);
+
+    Promise<V> ret;
+    ret.state->scheduler = &getCurrentScheduler();
+
+    flight->addContinuation([flight = flight.get(), dst = ret.state] () {
+        if (flight->status == PromiseStatus::Rejected)
+            dst->reject(flight->exception);
+        else
+            dst->resolve(*flight->value);
+    });
+
+    return ret;
+}
+
+
+/**
+ * Number of shards: a power of two, so picking one is a mask.
+ */
+inline size_t shardCount(size_t requested) {
+    return std::bit_ceil(std::max<size_t>(requested, 1));
+}
+
+
+}  // namespace vega::__cache_details
+
+
+namespace vega {
+
+
+/**
+ * Deduplicates concurrent calls for the same key, like Go's singleflight: while a call
+ * for a key is in flight, further calls for that key don't start their own, but wait for
+ * the one in flight and get a copy of its result (or its error).
+ *
+ * Keys are spread over shards, each with its own lock, so unrelated keys don't contend.
+ * [V] must be copyable.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class SingleFlight {
+protected:
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<K, std::shared_ptr<PromiseState<V>>, Hash, KeyEqual> inFlight;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardMask_;
+    Hash hash_;
+
+    std::atomic<size_t> calls_ {0};
+    std::atomic<size_t> coalesced_ {0};
+
+    Shard& shardOf(const K& key) { return shards_[hash_(key) & shardMask_]; }
+
+public:
+    explicit SingleFlight(size_t nShards = 16)
+        : shards_(std::make_unique<Shard[]>(__cache_details::shardCount(nShards))),
+          shardMask_(__cache_details::shardCount(nShards) - 1) {}
+
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator = (const SingleFlight&) = delete;
+
+
+    /**
+     * Run [fn] () (returning Promise<V>) for [key], unless a call for [key] is already
+     * in flight, in which case wait for that one instead.
+     *
+     * The SingleFlight must outlive calls in flight.
+     */
+    template <typename F>
+    Promise<V> run(const K& key, F&& fn) {
+        Shard& shard = shardOf(key);
+        std::shared_ptr<PromiseState<V>> flight;
+        {
+            std::lock_guard _l {shard.lock};
+
+            auto it = shard.inFlight.find(key);
+            if (it != shard.inFlight.end()) {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                return __cache_details::follow(it->second);
+            }
+
+            flight = PromiseState<V>::create();
+            flight->scheduler = &getCurrentScheduler();
+            shard.inFlight.emplace(key, flight);
+        }
+
+        calls_.fetch_add(1, std::memory_order_relaxed);
+
+        // Taken before starting [fn], which may finish (and erase the flight) right away.
+        auto ret = __cache_details::follow(flight);
+
+        std::shared_ptr<PromiseState<V>> source;
+        try {
+            source = std::invoke(std::forward<F>(fn)).getState();
+        }
+        catch (...) {
+            source = PromiseState<V>::create();
+            source->reject(std::current_exception());
+        }
+
+        source->addContinuation([&shard, key, flight, source = source.get()] () {
+            {
+                std::lock_guard _l {shard.lock};
+                shard.inFlight.erase(key);
+            }
+
+            if (source->status == PromiseStatus::Rejected)
+                flight->reject(source->exception);
+            else
+                flight->resolve(std::move(*source->value));
+        });
+
+        return ret;
+    }
+
+
+    /**
+     * Calls that actually ran their function.
+     */
+    size_t calls() const { return calls_.load(std::memory_order_relaxed); }
+
+    /**
+     * Calls that joined one already in flight instead.
+     */
+    size_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+};
+
+
+/**
+ * Async memoization cache with a TTL.
+ *
+ *     AsyncCache<std::string, Page> pages(
+ *         [] (const std::string& url) { return fetchPage(url); },
+ *         std::chrono::seconds(30)
+ *     );
+ *
+ *     Page page = co_await pages.get(url);
+ *
+ * A miss calls the loader through a SingleFlight, so any number of concurrent misses on
+ * the same key load it once. Loaded values are kept for [ttl]; failures aren't cached.
+ * Expiry is lazy: an expired entry is a miss and is dropped when looked up, and each shard
+ * sweeps out its other expired entries on an insert, at most once per [ttl]. No timers
+ * are involved, so cached entries don't keep `runBlocking` from returning.
+ *
+ * Entries are sharded like SingleFlight's in-flight calls. [V] must be copyable,
+ * and the cache must outlive loads in flight.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class AsyncCache {
+public:
+    using Loader = std::function<Promise<V>(const K&)>;
+
+    struct Stats {
+        size_t hits;
+        size_t misses;
+
+        /**
+         * Misses that waited for a load already in flight instead of starting one.
+         */
+        size_t coalesced;
+    };
+
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        V value;
+        Clock::time_point expiresAt;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<K, Entry, Hash, KeyEqual> entries;
+
+        /**
+         * When the next insert sweeps expired entries out.
+         */
+        Clock::time_point nextSweep {};
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardMask_;
+    Hash hash_;
+
+    Loader loader_;
+    Clock::duration ttl_;
+    SingleFlight<K, V, Hash, KeyEqual> flights_;
+
+    std::atomic<size_t> hits_ {0};
+    std::atomic<size_t> misses_ {0};
+
+    Shard& shardOf(const K& key) { return shards_[hash_(key) & shardMask_]; }
+
+
+    void insert(const K& key, V value) {
+        auto& shard = shardOf(key);
+        auto now = Clock::now();
+
+        std::lock_guard _l {shard.lock};
+
+        if (now >= shard.nextSweep) {
+            std::erase_if(shard.entries, [now] (const auto& it) { return it.second.expiresAt <= now; });
+            shard.nextSweep = now + ttl_;
+        }
+
+        shard.entries.insert_or_assign(key, Entry { .value = std::move(value), .expiresAt = now + ttl_ });
+    }
+
+
+public:
+    AsyncCache(Loader loader, Clock::duration ttl, size_t nShards = 16)
+        : shards_(std::make_unique<Shard[]>(__cache_details::shardCount(nShards))),
+          shardMask_(__cache_details::shardCount(nShards) - 1),
+          loader_(std::move(loader)), ttl_(ttl), flights_(nShards) {}
+
+    AsyncCache(const AsyncCache&) = delete;
+    AsyncCache& operator = (const AsyncCache&) = delete;
+
+
+    /**
+     * Get the cached value for [key], loading it on a miss.
+     */
+    Promise<V> get(const K& key) {
+        auto& shard = shardOf(key);
+        {
+            std::lock_guard _l {shard.lock};
+
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end()) {
+                if (it->second.expiresAt > Clock::now()) {
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return Promise<V>::resolve(it->second.value);
+                }
+
+                shard.entries.erase(it);
+            }
+        }
+
+        misses_.fetch_add(1, std::memory_order_relaxed);
+
+        return flights_.run(key, [this, &key] () {
+            return loader_(key).map([this, key] (V value) {
+                insert(key, value);
+                return value;
+            });
+        });
+    }
+
+
+    /**
+     * Cache [value] for [key], replacing what is there.
+     */
+    void put(const K& key, V value) { insert(key, std::move(value)); }
+
+
+    /**
+     * Drop [key]'s entry. A load in flight for it still completes and caches its result.
+     */
+    void invalidate(const K& key) {
+        auto& shard = shardOf(key);
+        std::lock_guard _l {shard.lock};
+        shard.entries.erase(key);
+    }
+
+
+    void clear() {
+        for (size_t i = 0; i <= shardMask_; i++) {
+            std::lock_guard _l {shards_[i].lock};
+            shards_[i].entries.clear();
+        }
+    }
+
+
+    /**
+     * Cached entries (including expired ones not swept out yet).
+     */
+    size_t size() {
+        size_t n = 0;
+        for (size_t i = 0; i <= shardMask_; i++) {
+            std::lock_guard _l {shards_[i].lock};
+            n += shards_[i].entries.size();
+        }
+        return n;
+    }
+
+
+    Stats stats() const {
+        return Stats {
+            .hits = hits_.load(std::memory_order_relaxed),
+            .misses = misses_.load(std::memory_order_relaxed),
+            .coalesced = flights_.coalesced(),
+        };
+    }
+};
+
+
+}  // namespace vega
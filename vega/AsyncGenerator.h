@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+
+namespace vega {
+
+
+/**
+ * Coroutine producing a stream of values with co_yield, consumed asynchronously:
+ *
+ *     AsyncGenerator<int> numbers() {
+ *         for (int i = 0; ; i++) {
+ *             co_await Scheduler::getCurrent().delay(1ms);
+ *             co_yield i;
+ *         }
+ *     }
+ *
+ *     auto gen = numbers();
+ *     while (auto x = co_await gen.next()) { ... }
+ *
+ * The generator is lazy: it doesn't start until the first `next()`, and after each co_yield
+ * it stays suspended until the consumer asks for the next value. So a slow consumer holds
+ * the producer back, and only one value is in flight at a time.
+ *
+ * Inside, the generator can co_await any Promise. Control passes directly between consumer
+ * and producer, so no scheduler task or allocation happens per value.
+ *
+ * The generator must outlive its consumers' pending `next()`, and it is not safe to call
+ * `next()` again before the previous one resumed.
+ */
+template <typename T>
+class AsyncGenerator {
+public:
+    using value_type = std::remove_cvref_t<T>;
+
+    struct promise_type {
+        /**
+         * Points to the operand of the pending co_yield, which lives in the generator's
+         * frame until it is resumed.
+         */
+        value_type* current = nullptr;
+
+        std::coroutine_handle<> consumer;
+        std::exception_ptr exception;
+
+        /**
+         * True while `next()` is resuming the generator from inside its await_suspend.
+         * If the generator yields before that returns, the consumer just continues
+         * instead of being resumed again, so synchronous streams don't grow the stack
+         * (symmetric transfer alone needs tail calls, which unoptimized builds lack).
+         */
+        std::atomic<bool> resuming {false};
+
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+
+        /**
+         * Hands control back to whoever is waiting in `next()`.
+         */
+        struct YieldAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                auto& promise = h.promise();
+                if (promise.resuming.exchange(false, std::memory_order_acq_rel))
+                    return std::noop_coroutine();  // `next()` is still on the stack and continues itself.
+
+                auto consumer = std::exchange(promise.consumer, nullptr);
+                return consumer ? consumer : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        YieldAwaiter final_suspend() noexcept {
+            current = nullptr;
+            return {};
+        }
+
+        YieldAwaiter yield_value(value_type& value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+
+        YieldAwaiter yield_value(value_type&& value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+
+    struct NextAwaiter {
+        std::coroutine_handle<promise_type> gen;
+
+        bool await_ready() { return !gen || gen.done(); }
+
+        bool await_suspend(std::coroutine_handle<> consumer) {
+            auto& promise = gen.promise();
+            promise.consumer = consumer;
+            promise.current = nullptr;
+            promise.resuming.store(true, std::memory_order_release);
+
+            gen.resume();
+
+            // Still set: the generator is waiting for something, and will resume us when it yields.
+            return promise.resuming.exchange(false, std::memory_order_acq_rel);
+        }
+
+        std::optional<value_type> await_resume() {
+            if (!gen)
+                return std::nullopt;
+
+            auto& promise = gen.promise();
+            if (promise.exception)
+                std::rethrow_exception(std::exchange(promise.exception, nullptr));
+
+            if (gen.done() || !promise.current)
+                return std::nullopt;
+
+            return std::move(*promise.current);
+        }
+    };
+
+
+protected:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+public:
+    AsyncGenerator() = default;
+
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator = (const AsyncGenerator&) = delete;
+
+    AsyncGenerator(AsyncGenerator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    AsyncGenerator& operator = (AsyncGenerator&& other) noexcept {
+        if (this != &other) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+
+        return *this;
+    }
+
+    /**
+     * Destroys the generator's frame. The generator must be suspended at a co_yield
+     * (or not started, or finished), not in the middle of a co_await.
+     */
+    ~AsyncGenerator() {
+        if (handle_)
+            handle_.destroy();
+    }
+
+
+    /**
+     * Resume the generator until it yields the next value.
+     * Resolves to std::nullopt once it finishes, and rethrows what it throws.
+     */
+    NextAwaiter next() { return NextAwaiter { handle_ }; }
+
+    bool done() const { return !handle_ || handle_.done(); }
+};
+
+
+}  // namespace vega
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+#include <vega/Scheduler.h>
+
+
+namespace vega {
+
+
+/**
+ * Collects independent single-key calls into batched calls, like DataLoader:
+ *
+ *     Batcher<BlockId, Block> blocks([] (std::vector<BlockId> ids) -> Promise<std::vector<Block>> {
+ *         co_return co_await readBlocks(ids);  // one request for all of them.
+ *     });
+ *
+ *     Block b = co_await blocks.load(id);
+ *
+ * Keys passed to `load` are queued. The queue is handed to the batch function at once
+ * when the first caller's current scheduler task is done (so everything loaded in the same
+ * tick goes together), or after `window` if one is set, or as soon as `maxBatchSize`
+ * keys are queued. The batch function returns one value per key, in the same order, which
+ * are then fanned back out to each `load`'s promise. If it fails, every load in the batch
+ * fails the same way.
+ *
+ * Duplicate keys are passed as they are; layer an AsyncCache on top to deduplicate.
+ */
+template <typename K, typename V>
+class Batcher {
+public:
+    using BatchFn = std::function<Promise<std::vector<V>>(std::vector<K>)>;
+
+    struct Options {
+        /**
+         * Flush as soon as this many keys are queued (0: no limit).
+         */
+        size_t maxBatchSize = 0;
+
+        /**
+         * How long a batch collects keys after its first one. Zero flushes when the
+         * scheduler task that queued the first key is done.
+         */
+        std::chrono::steady_clock::duration window {0};
+    };
+
+protected:
+    struct Batch {
+        std::vector<K> keys;
+        std::vector<std::shared_ptr<PromiseState<V>>> waiters;
+    };
+
+    /**
+     * Shared with scheduled flushes, which may run after the batcher is gone.
+     */
+    struct Core {
+        BatchFn fn;
+        Options options;
+
+        std::mutex lock;
+        Batch pending;
+
+        /**
+         * Bumped whenever a batch is taken, so a scheduled flush for an earlier batch
+         * doesn't flush the current one early.
+         */
+        std::uint64_t generation = 0;
+
+        /**
+         * Timer of the pending batch, if `window` is set. Cancelled when the batch
+         * is flushed before it fires.
+         */
+        std::shared_ptr<PromiseState<void>> timer;
+
+        size_t batches = 0;
+
+
+        /**
+         * Take the pending batch if it still is [generation]. Must hold `lock`.
+         */
+        Batch take(std::uint64_t generation, std::shared_ptr<PromiseState<void>>& timer) {
+            if (generation != this->generation || pending.keys.empty())
+                return {};
+
+            this->generation++;
+            batches++;
+            timer = std::move(this->timer);
+            return std::exchange(pending, {});
+        }
+
+
+        void flush(std::uint64_t generation) {
+            Batch batch;
+            std::shared_ptr<PromiseState<void>> timer;
+            {
+                std::lock_guard _l {lock};
+                batch = take(generation, timer);
+            }
+
+            if (timer)
+                timer->cancel();
+
+            if (!batch.keys.empty())
+                run(std::move(batch));
+        }
+
+
+        void run(Batch batch) {
+            std::shared_ptr<PromiseState<std::vector<V>>> result;
+            try {
+                result = fn(std::move(batch.keys)).getState();
+            }
+            catch (...) {
+                result = PromiseState<std::vector<V>>::create();
+                result->reject(std::current_exception());
+            }
+
+            result->addContinuation([waiters = std::move(batch.waiters), result = result.get()] () {
+                std::exception_ptr error = result->exception;
+
+                if (!error && result->value->size() != waiters.size()) {
+                    error = std::make_exception_ptr(std::length_error(
+                        "Batcher: batch function returned " + std::to_string(result->value->size())
+                        + " values for " + std::to_string(waiters.size()) + " keys"
+                    ));
+                }
+
+                for (size_t i = 0; i < waiters.size(); i++) {
+                    if (error)
+                        waiters[i]->reject(error);
+                    else
+                        waiters[i]->resolve(std::move((*result->value)[i]));
+                }
+            });
+        }
+    };
+
+    std::shared_ptr<Core> core_;
+
+
+public:
+    explicit Batcher(BatchFn fn, Options options = {}) : core_(std::make_shared<Core>()) {
+        core_->fn = std::move(fn);
+        core_->options = options;
+    }
+
+    Batcher(const Batcher&) = delete;
+    Batcher& operator = (const Batcher&) = delete;
+
+    /**
+     * Flushes what is still queued, so no load is left hanging.
+     */
+    ~Batcher() { flush(); }
+
+
+    /**
+     * Queue [key] for the next batch, and get its value once the batch is done.
+     */
+    Promise<V> load(K key) {
+        Promise<V> ret;
+        auto& scheduler = getCurrentScheduler();
+        ret.state->scheduler = &scheduler;
+
+        std::uint64_t generation;
+        bool first;
+        bool full;
+        {
+            std::lock_guard _l {core_->lock};
+
+            generation = core_->generation;
+            first = core_->pending.keys.empty();
+
+            core_->pending.keys.push_back(std::move(key));
+            core_->pending.waiters.push_back(ret.state);
+
+            size_t max = core_->options.maxBatchSize;
+            full = max > 0 && core_->pending.keys.size() >= max;
+
+            if (first && !full && core_->options.window.count() > 0) {
+                auto timer = scheduler.delay(core_->options.window).getState();
+                timer->addContinuation([weakCore = std::weak_ptr<Core>(core_), generation, timer = timer.get()] () {
+                    if (timer->status != PromiseStatus::Fulfilled)
+                        return;  // cancelled: the batch was flushed already.
+
+                    if (auto core = weakCore.lock())
+                        core->flush(generation);
+                });
+                core_->timer = std::move(timer);
+            }
+        }
+
+        if (full) {
+            core_->flush(generation);
+        }
+        else if (first && core_->options.window.count() == 0) {
+            // Not `addTask`: another worker could flush while this task is still loading keys.
+            scheduler.addTaskAfterCurrent([weakCore = std::weak_ptr<Core>(core_), generation] () {
+                if (auto core = weakCore.lock())
+                    core->flush(generation);
+            });
+        }
+
+        return ret;
+    }
+
+
+    /**
+     * Send the queued keys to the batch function now.
+     */
+    void flush() {
+        std::uint64_t generation;
+        {
+            std::lock_guard _l {core_->lock};
+            generation = core_->generation;
+        }
+
+        core_->flush(generation);
+    }
+
+
+    /**
+     * Batches sent to the batch function so far.
+     */
+    size_t batches() {
+        std::lock_guard _l {core_->lock};
+        return core_->batches;
+    }
+};
+
+
+}  // namespace vega
@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+
+
+namespace vega {
+
+
+struct ChannelClosedError : std::runtime_error {
+    ChannelClosedError() : std::runtime_error("channel closed") {}
+};
+
+
+/**
+ * Bounded multi-producer multi-consumer channel between coroutines.
+ *
+ * `co_await send(v)` suspends while the channel is full, and `co_await recv()` suspends
+ * while it is empty, instead of blocking the thread. Values live in a lock-free ring
+ * buffer (Dmitry Vyukov's bounded MPMC queue), so while the channel is neither full
+ * nor empty, send and recv take no lock and allocate nothing. The mutex is only taken
+ * to park or wake suspended senders and receivers.
+ *
+ * After `close()`, sends fail with ChannelClosedError, and receivers drain the remaining
+ * values and then get std::nullopt.
+ *
+ * A pending send or recv can be cancelled (for instance by losing a promiseRace): it stops
+ * waiting and rejects with CancelledError, and the value of a cancelled send is dropped.
+ *
+ * The channel must outlive every pending send and recv.
+ */
+template <typename T>
+class Channel {
+protected:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        std::optional<T> value;
+    };
+
+    struct SendWaiter {
+        std::shared_ptr<PromiseState<void>> state;
+        T value;
+    };
+
+    using RecvState = PromiseState<std::optional<T>>;
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(64) std::atomic<size_t> enqueuePos_ {0};
+    alignas(64) std::atomic<size_t> dequeuePos_ {0};
+
+    alignas(64) std::atomic<bool> closed_ {false};
+
+    /**
+     * Number of parked senders / receivers, so the fast path can skip the lock when there are none.
+     */
+    std::atomic<size_t> nSendWaiters_ {0};
+    std::atomic<size_t> nRecvWaiters_ {0};
+
+    std::mutex waitersLock_;
+    std::deque<SendWaiter> sendWaiters_;
+    std::deque<std::shared_ptr<RecvState>> recvWaiters_;
+
+
+    bool push(T& value) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) pos;
+
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value.emplace(std::move(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;  // full
+            }
+            else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    std::optional<T> pop() {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) (pos + 1);
+
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> value = std::move(cell.value);
+                    cell.value.reset();
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return value;
+                }
+            }
+            else if (diff < 0) {
+                return std::nullopt;  // empty
+            }
+            else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    /**
+     * Promises settled by the slow path. They are settled after the lock is released,
+     * since settling resumes coroutines that may use the channel again.
+     */
+    struct Wakeups {
+        std::vector<std::pair<std::shared_ptr<RecvState>, std::optional<T>>> receivers;
+        std::vector<std::shared_ptr<PromiseState<void>>> senders;
+        std::vector<std::shared_ptr<PromiseState<void>>> rejectedSenders;
+
+        void run() {
+            for (auto& [state, value] : receivers)
+                state->resolve(std::move(value));
+            for (auto& state : senders)
+                state->resolve();
+            for (auto& state : rejectedSenders)
+                state->reject(std::make_exception_ptr(ChannelClosedError()));
+        }
+    };
+
+
+    /**
+     * Move values to parked receivers and parked senders' values into freed slots,
+     * as far as possible. Must hold waitersLock_.
+     */
+    void matchWaiters(Wakeups& wakeups) {
+        bool progress = true;
+
+        while (progress) {
+            progress = false;
+
+            while (!recvWaiters_.empty()) {
+                auto value = pop();
+                if (!value)
+                    break;
+
+                wakeups.receivers.emplace_back(std::move(recvWaiters_.front()), std::move(value));
+                recvWaiters_.pop_front();
+                nRecvWaiters_--;
+                progress = true;
+            }
+
+            while (!sendWaiters_.empty() && push(sendWaiters_.front().value)) {
+                wakeups.senders.push_back(std::move(sendWaiters_.front().state));
+                sendWaiters_.pop_front();
+                nSendWaiters_--;
+                progress = true;
+            }
+        }
+
+        if (closed_.load(std::memory_order_acquire)) {
+            // Nothing will arrive anymore: parked receivers get nullopt, parked senders fail.
+            // (Buffered values were already handed out above, or there are no receivers.)
+            for (auto& state : recvWaiters_)
+                wakeups.receivers.emplace_back(std::move(state), std::nullopt);
+            recvWaiters_.clear();
+            nRecvWaiters_ = 0;
+
+            for (auto& waiter : sendWaiters_)
+                wakeups.rejectedSenders.push_back(std::move(waiter.state));
+            sendWaiters_.clear();
+            nSendWaiters_ = 0;
+        }
+    }
+
+
+    /**
+     * Cancel hooks of parked receivers and senders: stop waiting and reject with CancelledError.
+     * A waiter that was just handed a value (or a slot) is no longer parked, and is left to settle.
+     */
+    void dropRecvWaiter(RecvState* state) {
+        {
+            std::lock_guard _l {waitersLock_};
+
+            auto it = std::ranges::find_if(recvWaiters_, [state] (auto& waiter) { return waiter.get() == state; });
+            if (it == recvWaiters_.end())
+                return;
+
+            recvWaiters_.erase(it);
+            nRecvWaiters_--;
+        }
+
+        state->reject(std::make_exception_ptr(CancelledError()));
+    }
+
+    void dropSendWaiter(PromiseState<void>* state) {
+        {
+            std::lock_guard _l {waitersLock_};
+
+            auto it = std::ranges::find_if(sendWaiters_, [state] (auto& waiter) { return waiter.state.get() == state; });
+            if (it == sendWaiters_.end())
+                return;
+
+            sendWaiters_.erase(it);
+            nSendWaiters_--;
+        }
+
+        state->reject(std::make_exception_ptr(CancelledError()));
+    }
+
+
+    void wakeIfWaiting() {
+        // Pairs with the fence in the slow paths: either we see their waiter, or they see our change.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (nRecvWaiters_.load(std::memory_order_relaxed) == 0 && nSendWaiters_.load(std::memory_order_relaxed) == 0)
+            return;
+
+        Wakeups wakeups;
+        {
+            std::lock_guard _l {waitersLock_};
+            matchWaiters(wakeups);
+        }
+        wakeups.run();
+    }
+
+
+public:
+    /**
+     * @param capacity Rounded up to a power of two (at least 2).
+     */
+    explicit Channel(size_t capacity)
+        : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          cells_(std::make_unique<Cell[]>(mask_ + 1))
+    {
+        for (size_t i = 0; i <= mask_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator = (const Channel&) = delete;
+
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+
+    /**
+     * Send without waiting. Returns false if the channel is full or closed.
+     */
+    bool trySend(T value) {
+        if (closed() || !push(value))
+            return false;
+
+        wakeIfWaiting();
+        return true;
+    }
+
+
+    /**
+     * Receive without waiting. Returns std::nullopt if the channel is empty.
+     */
+    std::optional<T> tryRecv() {
+        auto value = pop();
+        if (value)
+            wakeIfWaiting();
+        return value;
+    }
+
+
+    /**
+     * Send [value], suspending while the channel is full.
+     * Rejects with ChannelClosedError if the channel is (or gets) closed first.
+     */
+    Promise<void> send(T value) {
+        if (closed())
+            return Promise<void>::reject(ChannelClosedError());
+
+        if (push(value)) {
+            wakeIfWaiting();
+            return Promise<void>::resolve();
+        }
+
+        Promise<void> ret;
+        ret.state->scheduler = &getCurrentScheduler();
+
+        Wakeups wakeups;
+        {
+            std::lock_guard _l {waitersLock_};
+
+            sendWaiters_.push_back({ ret.state, std::move(value) });
+            nSendWaiters_++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // A receiver may have freed a slot meanwhile (or closed the channel).
+            matchWaiters(wakeups);
+        }
+        wakeups.run();
+
+        ret.state->onCancel([this, state = ret.state.get()] () { dropSendWaiter(state); });
+
+        return ret;
+    }
+
+
+    /**
+     * Receive a value, suspending while the channel is empty.
+     * Resolves to std::nullopt once the channel is closed and drained.
+     */
+    Promise<std::optional<T>> recv() {
+        if (auto value = pop()) {
+            wakeIfWaiting();
+            return Promise<std::optional<T>>::resolve(std::move(value));
+        }
+
+        if (closed()) {
+            // Closing may race with the last sends, so look once more.
+            auto value = pop();
+            return Promise<std::optional<T>>::resolve(std::move(value));
+        }
+
+        Promise<std::optional<T>> ret;
+        ret.state->scheduler = &getCurrentScheduler();
+
+        Wakeups wakeups;
+        {
+            std::lock_guard _l {waitersLock_};
+
+            recvWaiters_.push_back(ret.state);
+            nRecvWaiters_++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // A sender may have filled a slot meanwhile (or the channel got closed).
+            matchWaiters(wakeups);
+        }
+        wakeups.run();
+
+        ret.state->onCancel([this, state = ret.state.get()] () { dropRecvWaiter(state); });
+
+        return ret;
+    }
+
+
+    /**
+     * Receive up to [maxCount] values: waits for the first one like `recv`, then takes
+     * whatever else is already buffered without waiting.
+     * Resolves to an empty vector once the channel is closed and drained.
+     */
+    Promise<std::vector<T>> recvBatch(size_t maxCount) {
+        std::vector<T> batch;
+
+        auto first = co_await recv();
+        if (!first)
+            co_return batch;
+
+        batch.reserve(std::min(maxCount, capacity()));
+        batch.push_back(std::move(*first));
+
+        while (batch.size() < maxCount) {
+            auto value = pop();
+            if (!value)
+                break;
+            batch.push_back(std::move(*value));
+        }
+
+        wakeIfWaiting();
+        co_return batch;
+    }
+
+
+    /**
+     * Close the channel. Buffered values can still be received.
+     */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+
+        Wakeups wakeups;
+        {
+            std::lock_guard _l {waitersLock_};
+            matchWaiters(wakeups);
+        }
+        wakeups.run();
+    }
+};
+
+
+}  // namespace vega
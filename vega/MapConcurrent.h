@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+
+
+/**
+ * namespace vega::__map_concurrent_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace vega::__map_concurrent_details {
+
+
+template <typename R>
+using view_t = std::views::all_t<R>;
+
+template <typename R>
+using item_t = std::ranges::range_value_t<view_t<R>>;
+
+/**
+ * What [F] resolves to for items of [R] (U for both U and Promise<U>).
+ */
+template <typename R, typename F>
+using result_t = __promise_all_details::unwrap_t<std::invoke_result_t<F&, item_t<R>&&>>;
+
+
+/**
+ * State shared by the workers of one mapConcurrent call.
+ *
+ * Workers pull the next item from the range only when they are free, so at most
+ * `maxInFlight` items are taken from the range but not finished yet.
+ */
+template <typename R, typename F, typename Sink>
+struct Shared {
+    using View = view_t<R>;
+    using Item = item_t<R>;
+    using Result = result_t<R, F>;
+
+    /**
+     * Items of rvalue ranges are moved out, items of lvalue ranges are copied.
+     */
+    static constexpr bool MoveItems = !std::is_lvalue_reference_v<R>;
+
+    View view;
+    std::ranges::iterator_t<View> it;
+    size_t nextIndex = 0;
+
+    F fn;
+    Sink sink;
+
+    std::exception_ptr error;
+
+    /**
+     * Protects everything above, since workers may resume on different threads.
+     */
+    std::mutex lock;
+
+
+    template <typename R2>
+    Shared(R2&& range, F fn, Sink sink)
+        : view(std::views::all(std::forward<R2>(range))), fn(std::move(fn)), sink(std::move(sink)) {
+        it = std::ranges::begin(view);
+    }
+
+
+    /**
+     * Take the next item, or nothing if the range is exhausted or some item failed.
+     */
+    std::optional<std::pair<size_t, Item>> take() {
+        std::lock_guard _l {lock};
+
+        if (error || it == std::ranges::end(view))
+            return std::nullopt;
+
+        std::optional<std::pair<size_t, Item>> item;
+        if constexpr (MoveItems)
+            item.emplace(nextIndex++, std::ranges::iter_move(it));
+        else
+            item.emplace(nextIndex++, *it);
+
+        ++it;
+        return item;
+    }
+
+
+    void fail(std::exception_ptr e) {
+        std::lock_guard _l {lock};
+        if (!error)
+            error = e;
+    }
+};
+
+
+/**
+ * Await [x] if it is a promise.
+ */
+template <typename X>
+Promise<__promise_all_details::unwrap_t<X>> toPromise(X&& x) {
+    if constexpr (__promise_details::is_promise<std::remove_cvref_t<X>>::value)
+        return std::forward<X>(x);
+    else
+        return Promise<X>::resolve(std::forward<X>(x));
+}
+
+
+template <typename S>
+Promise<> worker(std::shared_ptr<S> s) {
+    using U = typename S::Result;
+
+    while (auto item = s->take()) {
+        auto& [index, value] = *item;
+
+        try {
+            if constexpr (std::is_void_v<U>) {
+                if constexpr (__promise_details::is_promise<std::invoke_result_t<decltype(s->fn)&, typename S::Item&&>>::value)
+                    co_await std::invoke(s->fn, std::move(value));
+                else
+                    std::invoke(s->fn, std::move(value));
+
+                if constexpr (__promise_details::is_promise<std::invoke_result_t<decltype(s->sink)&, size_t>>::value)
+                    co_await std::invoke(s->sink, index);
+                else
+                    std::invoke(s->sink, index);
+            }
+            else {
+                U result = co_await toPromise(std::invoke(s->fn, std::move(value)));
+
+                // Awaiting a promise returned by the sink holds this worker back,
+                // so slow consumers throttle how fast items are taken.
+                if constexpr (__promise_details::is_promise<std::invoke_result_t<decltype(s->sink)&, size_t, U&&>>::value)
+                    co_await std::invoke(s->sink, index, std::move(result));
+                else
+                    std::invoke(s->sink, index, std::move(result));
+            }
+        }
+        catch (...) {
+            s->fail(std::current_exception());
+        }
+    }
+}
+
+
+}  // namespace vega::__map_concurrent_details
+
+
+namespace vega {
+
+
+/**
+ * Run [fn] over every item of [range], with at most [maxInFlight] calls running at once.
+ * [fn] takes an item and returns U or Promise<U>.
+ *
+ * Each result is passed to [onResult] (index, U) as soon as it is ready, so in completion order
+ * (for void results, [onResult] (index)). If [onResult] returns a Promise, the worker waits
+ * for it before taking the next item, which applies backpressure from the consumer.
+ *
+ * The range is consumed lazily: an item is only taken when a worker is free. So lazy views
+ * (like std::views::iota | std::views::transform) are never materialized. Lvalue ranges
+ * must outlive the returned promise.
+ *
+ * After the first failure (of [fn] or [onResult]), no more items are taken, and the returned
+ * promise rejects with that failure once the running calls finish.
+ */
+template <std::ranges::input_range R, typename F, typename Sink>
+Promise<> mapConcurrent(R&& range, size_t maxInFlight, F fn, Sink onResult) {
+    using namespace vega::__map_concurrent_details;
+    using S = Shared<R, F, Sink>;
+
+    auto s = std::make_shared<S>(std::forward<R>(range), std::move(fn), std::move(onResult));
+
+    std::vector<Promise<>> workers;
+    workers.reserve(maxInFlight);
+    for (size_t i = 0; i < std::max<size_t>(maxInFlight, 1); i++)
+        workers.push_back(worker(s));
+
+    co_await promiseAll(std::move(workers));
+
+    if (s->error)
+        std::rethrow_exception(s->error);
+}
+
+
+/**
+ * Like mapConcurrent with a sink, but collects the results into a std::vector in input order
+ * (or resolves to void if [fn] resolves to void).
+ *
+ * Results that finished early wait in the result slots, so memory grows with the input.
+ * Use the sink version to stream them instead.
+ */
+template <std::ranges::input_range R, typename F>
+auto mapConcurrent(R&& range, size_t maxInFlight, F fn)
+    -> Promise<std::conditional_t<
+        std::is_void_v<__map_concurrent_details::result_t<R, F>>,
+        void,
+        std::vector<__map_concurrent_details::result_t<R, F>>
+    >>
+{
+    using U = __map_concurrent_details::result_t<R, F>;
+
+    if constexpr (std::is_void_v<U>) {
+        co_await mapConcurrent(std::forward<R>(range), maxInFlight, std::move(fn), [] (size_t) {});
+    }
+    else {
+        struct Slots {
+            std::vector<std::optional<U>> values;
+            std::mutex lock;
+        };
+
+        auto slots = std::make_shared<Slots>();
+
+        co_await mapConcurrent(std::forward<R>(range), maxInFlight, std::move(fn), [slots] (size_t index, U&& value) {
+            std::lock_guard _l {slots->lock};
+            if (slots->values.size() <= index)
+                slots->values.resize(index + 1);
+            slots->values[index].emplace(std::move(value));
+        });
+
+        std::vector<U> results;
+        results.reserve(slots->values.size());
+        for (auto& value : slots->values)
+            results.push_back(std::move(*value));
+
+        co_return results;
+    }
+}
+
+
+}  // namespace vega
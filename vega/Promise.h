@@ -5,7 +5,10 @@
 
 #include <coroutine>
 #include <exception>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <type_traits>
 
 #include <vega/PromiseState.h>
 
@@ -17,25 +20,151 @@ namespace vega {
 class Scheduler;
 Scheduler& getCurrentScheduler();
 
+template <typename T>
+class Promise;
+
+
+/**
+ * namespace vega::__promise_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace __promise_details {
+
+template <typename T>
+struct is_promise : std::false_type {};
+
+template <typename T>
+struct is_promise<Promise<T>> : std::true_type {};
+
+
+/**
+ * Called when a coroutine resumes from co_await. A cancelled coroutine throws
+ * CancelledError here, whatever the awaited promise settled with.
+ */
+inline void leaveAwait(PromiseStateBase* parent) {
+    if (!parent)
+        return;
+
+    parent->clearAwaiting();
+    if (parent->cancelled)
+        throw CancelledError();
+}
+
+
+/**
+ * Settle [dst] with the result of calling [f], or with the exception it throws.
+ */
+template <typename U, typename F, typename... Args>
+void resolveWith(PromiseState<U>* dst, F& f, Args&&... args) {
+    try {
+        if constexpr (std::is_void_v<U>) {
+            std::invoke(f, std::forward<Args>(args)...);
+            dst->resolve();
+        }
+        else {
+            dst->resolve(std::invoke(f, std::forward<Args>(args)...));
+        }
+    }
+    catch (...) {
+        dst->reject(std::current_exception());
+    }
+}
+
+
+/**
+ * State of promises created by `map`, `then` and `catchError`.
+ *
+ * The callback lives right inside the state, and the state keeps itself alive until
+ * the promise it listens to settles. So the continuation registered on the source only
+ * captures two raw pointers, which std::function stores without allocating.
+ */
+template <typename U, typename Handler>
+class CallbackState : public PromiseState<U> {
+public:
+    Handler handler;
+    std::shared_ptr<PromiseStateBase> self;
+
+    template <typename H>
+    CallbackState(H&& handler) : handler(std::forward<H>(handler)) {}
+
+    /**
+     * Settle with the outcome of [inner] once it settles (used by `then` to flatten).
+     */
+    void adopt(Promise<U> inner);
+};
+
+
+/**
+ * Call [handler] (dst, src) once [src] settles, where dst is the state of the returned promise.
+ */
+template <typename U, typename S, typename Handler>
+Promise<U> listen(const std::shared_ptr<PromiseState<S>>& src, Handler&& handler) {
+    using State = CallbackState<U, std::decay_t<Handler>>;
+
+    auto dst = std::make_shared<State>(std::forward<Handler>(handler));
+    dst->scheduler = src->scheduler;
+    dst->setAwaiting(src);
+    dst->self = dst;
+
+    src->addContinuation([src = src.get(), dst = dst.get()] () {
+        auto keepAlive = std::move(dst->self);
+        dst->handler(dst, src);
+    });
+
+    return Promise<U>(std::shared_ptr<PromiseState<U>>(std::move(dst)));
+}
+
+
+}  // namespace __promise_details
+
 
 template <typename T = void>
 class Promise {
 public:
+    using value_type = T;
+
+    /**
+     * Null if the promise was created already fulfilled (see `resolve`).
+     * The value lives inline in `readyValue` then, and no state is allocated.
+     */
     std::shared_ptr<PromiseState<T>> state;
 
+protected:
+    std::optional<T> readyValue;
+
+    struct ReadyTag {};
+
+    Promise(ReadyTag, T&& value) : readyValue(std::move(value)) {}
+    Promise(ReadyTag, const T& value) : readyValue(value) {}
+
+public:
     Promise() : state(PromiseState<T>::create()) {}
     Promise(std::shared_ptr<PromiseState<T>> state) : state(state) {}
 
     static Promise<T> resolve(T&& value) {
-        Promise<T> p;
-        p.state->resolve(std::move(value));
-        return p;
+        return Promise<T>(ReadyTag{}, std::move(value));
     }
 
     static Promise<T> resolve(T& value) {
-        Promise<T> p;
-        p.state->resolve(value);
-        return p;
+        return Promise<T>(ReadyTag{}, value);
+    }
+
+    /**
+     * True if awaiting this promise won't suspend.
+     */
+    bool settled() const { return !state || state->status != PromiseStatus::Pending; }
+
+    /**
+     * Get the shared state of this promise. For promises created already fulfilled,
+     * a state is allocated and the inline value is moved into it.
+     */
+    std::shared_ptr<PromiseState<T>> getState() {
+        if (!state) {
+            state = PromiseState<T>::create();
+            state->resolve(std::move(*readyValue));
+            readyValue.reset();
+        }
+
+        return state;
     }
 
     static Promise<T> reject(std::exception_ptr e) {
@@ -65,6 +194,100 @@ public:
         return p;
     }
 
+    /**
+     * Transform the fulfilled value with [f] (T -> U) without a coroutine frame.
+     * Rejections pass through, and exceptions thrown by [f] reject the returned promise.
+     *
+     * If this promise is already fulfilled, [f] runs right away and nothing is allocated.
+     * Otherwise [f] is stored in the returned promise's state (a single allocation).
+     * Like co_await, the value is moved out of this promise.
+     */
+    template <typename F>
+    auto map(F&& f) -> Promise<std::invoke_result_t<F, T&&>> {
+        using U = std::invoke_result_t<F, T&&>;
+
+        if (!state) {
+            try {
+                if constexpr (std::is_void_v<U>) {
+                    std::invoke(f, std::move(*readyValue));
+                    return Promise<U>::resolve();
+                }
+                else {
+                    return Promise<U>::resolve(std::invoke(f, std::move(*readyValue)));
+                }
+            }
+            catch (...) {
+                return Promise<U>::reject(std::current_exception());
+            }
+        }
+
+        return __promise_details::listen<U>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<T>* src) mutable {
+            if (src->exception)
+                dst->reject(src->exception);
+            else
+                __promise_details::resolveWith(dst, f, std::move(*src->value));
+        });
+    }
+
+
+    /**
+     * Like `map`, but if [f] returns a Promise<U>, the returned promise follows it
+     * (so this also works as flatMap).
+     */
+    template <typename F>
+    auto then(F&& f) {
+        using R = std::invoke_result_t<F, T&&>;
+
+        if constexpr (!__promise_details::is_promise<R>::value) {
+            return this->map(std::forward<F>(f));
+        }
+        else {
+            using U = typename R::value_type;
+
+            if (!state) {
+                try {
+                    return std::invoke(f, std::move(*readyValue));
+                }
+                catch (...) {
+                    return Promise<U>::reject(std::current_exception());
+                }
+            }
+
+            return __promise_details::listen<U>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<T>* src) mutable {
+                if (src->exception) {
+                    dst->reject(src->exception);
+                    return;
+                }
+
+                try {
+                    dst->adopt(std::invoke(f, std::move(*src->value)));
+                }
+                catch (...) {
+                    dst->reject(std::current_exception());
+                }
+            });
+        }
+    }
+
+
+    /**
+     * Recover from a rejection with [f] (std::exception_ptr -> T).
+     * Fulfilled values pass through.
+     */
+    template <typename F>
+    Promise<T> catchError(F&& f) {
+        if (!state)
+            return std::move(*this);
+
+        return __promise_details::listen<T>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<T>* src) mutable {
+            if (src->exception)
+                __promise_details::resolveWith(dst, f, src->exception);
+            else
+                dst->resolve(std::move(*src->value));
+        });
+    }
+
+
     struct promise_type {
         std::shared_ptr<PromiseState<T>> state = PromiseState<T>::create();
 
@@ -76,15 +299,21 @@ public:
         std::suspend_never initial_suspend() { return {}; }
         std::suspend_never final_suspend() noexcept { return {}; }
 
-        auto return_value(T&& v) { state->resolve(v); }
+        void return_value(T v) { state->resolve(std::move(v)); }
         void unhandled_exception() { state->reject(std::current_exception()); }
     };
     
 
     struct Awaiter {
         std::shared_ptr<PromiseState<T>> state;
+        std::optional<T>* readyValue;
+
+        /**
+         * State of the suspended coroutine, if it is a Promise coroutine.
+         */
+        PromiseStateBase* parent = nullptr;
 
-        bool await_ready() { return state->status != PromiseStatus::Pending; }
+        bool await_ready() { return !state || state->status != PromiseStatus::Pending; }
 
         template<typename PromiseType>
         void await_suspend(std::coroutine_handle<PromiseType> h) {
@@ -92,24 +321,35 @@ public:
                 if (h.promise().state->scheduler == nullptr) {
                     h.promise().state->scheduler = state->scheduler;
                 }
+
+                parent = h.promise().state.get();
+                parent->setAwaiting(state);
             }
             state->addContinuation( [h] () { h.resume(); } );
         }
         
         T&& await_resume() {
+            __promise_details::leaveAwait(parent);
+            if (!state)
+                return std::move(**readyValue);
             if (state->exception)
                 std::rethrow_exception(state->exception);
             return std::move(*state->value);
         }
     };
 
-    Awaiter operator co_await() { return Awaiter{state}; }
+    Awaiter operator co_await() { return Awaiter{state, &readyValue}; }
 };
 
 
 template<>
 class Promise<void> {
 public:
+    using value_type = void;
+
+    /**
+     * Null if the promise was created already fulfilled (see `resolve`).
+     */
     std::shared_ptr<PromiseState<void>> state;
 
     Promise() : state(PromiseState<void>::create()) {}
@@ -117,9 +357,25 @@ public:
 
 
     static Promise<void> resolve() {
-        Promise<void> p;
-        p.state->resolve();
-        return p;
+        return Promise<void>(nullptr);
+    }
+
+    /**
+     * True if awaiting this promise won't suspend.
+     */
+    bool settled() const { return !state || state->status != PromiseStatus::Pending; }
+
+    /**
+     * Get the shared state of this promise. For promises created already fulfilled,
+     * a fulfilled state is allocated.
+     */
+    std::shared_ptr<PromiseState<void>> getState() {
+        if (!state) {
+            state = PromiseState<void>::create();
+            state->resolve();
+        }
+
+        return state;
     }
 
     static Promise<void> reject(std::exception_ptr e) {
@@ -151,6 +407,95 @@ public:
         return p;
     }
 
+    /**
+     * Run [f] (() -> U) once this promise is fulfilled, without a coroutine frame.
+     * See Promise<T>::map.
+     */
+    template <typename F>
+    auto map(F&& f) -> Promise<std::invoke_result_t<F>> {
+        using U = std::invoke_result_t<F>;
+
+        if (!state) {
+            try {
+                if constexpr (std::is_void_v<U>) {
+                    std::invoke(f);
+                    return Promise<U>::resolve();
+                }
+                else {
+                    return Promise<U>::resolve(std::invoke(f));
+                }
+            }
+            catch (...) {
+                return Promise<U>::reject(std::current_exception());
+            }
+        }
+
+        return __promise_details::listen<U>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<void>* src) mutable {
+            if (src->exception)
+                dst->reject(src->exception);
+            else
+                __promise_details::resolveWith(dst, f);
+        });
+    }
+
+
+    /**
+     * Like `map`, but if [f] returns a Promise<U>, the returned promise follows it.
+     * See Promise<T>::then.
+     */
+    template <typename F>
+    auto then(F&& f) {
+        using R = std::invoke_result_t<F>;
+
+        if constexpr (!__promise_details::is_promise<R>::value) {
+            return this->map(std::forward<F>(f));
+        }
+        else {
+            using U = typename R::value_type;
+
+            if (!state) {
+                try {
+                    return std::invoke(f);
+                }
+                catch (...) {
+                    return Promise<U>::reject(std::current_exception());
+                }
+            }
+
+            return __promise_details::listen<U>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<void>* src) mutable {
+                if (src->exception) {
+                    dst->reject(src->exception);
+                    return;
+                }
+
+                try {
+                    dst->adopt(std::invoke(f));
+                }
+                catch (...) {
+                    dst->reject(std::current_exception());
+                }
+            });
+        }
+    }
+
+
+    /**
+     * Recover from a rejection with [f] (std::exception_ptr -> void).
+     */
+    template <typename F>
+    Promise<void> catchError(F&& f) {
+        if (!state)
+            return *this;
+
+        return __promise_details::listen<void>(state, [f = std::forward<F>(f)] (auto* dst, PromiseState<void>* src) mutable {
+            if (src->exception)
+                __promise_details::resolveWith(dst, f, src->exception);
+            else
+                dst->resolve();
+        });
+    }
+
+
     struct promise_type {
         std::shared_ptr<PromiseState<void>> state = PromiseState<void>::create();
 
@@ -170,8 +515,13 @@ public:
     struct Awaiter {
         std::shared_ptr<PromiseState<void>> state;
 
+        /**
+         * State of the suspended coroutine, if it is a Promise coroutine.
+         */
+        PromiseStateBase* parent = nullptr;
+
         bool await_ready() {
-            return state->status != PromiseStatus::Pending;
+            return !state || state->status != PromiseStatus::Pending;
         }
 
         template<typename PromiseType>
@@ -180,13 +530,17 @@ public:
                 if (h.promise().state->scheduler == nullptr) {
                     h.promise().state->scheduler = state->scheduler;
                 }
+
+                parent = h.promise().state.get();
+                parent->setAwaiting(state);
             }
 
             state->addContinuation( [h] () { h.resume(); } );
         }
         
         void await_resume() {
-            if (state->exception)
+            __promise_details::leaveAwait(parent);
+            if (state && state->exception)
                 std::rethrow_exception(state->exception);
         }
     };
@@ -195,4 +549,41 @@ public:
 };
 
 
+template <typename U, typename Handler>
+void __promise_details::CallbackState<U, Handler>::adopt(Promise<U> inner) {
+    auto awaiter = inner.operator co_await();
+
+    if (!awaiter.await_ready()) {
+        this->self = this->getPtr();
+        if (this->setAwaiting(inner.state))
+            inner.state->cancel();
+
+        inner.state->addContinuation([inner = inner.state.get(), dst = this] () {
+            auto keepAlive = std::move(dst->self);
+            if (inner->exception)
+                dst->reject(inner->exception);
+            else if constexpr (std::is_void_v<U>)
+                dst->resolve();
+            else
+                dst->resolve(std::move(*inner->value));
+        });
+
+        return;
+    }
+
+    try {
+        if constexpr (std::is_void_v<U>) {
+            awaiter.await_resume();
+            this->resolve();
+        }
+        else {
+            this->resolve(awaiter.await_resume());
+        }
+    }
+    catch (...) {
+        this->reject(std::current_exception());
+    }
+}
+
+
 }  // namespace vega
@@ -4,10 +4,13 @@
 #pragma once
 
 #include <tuple>
+#include <optional>
+#include <utility>
+#include <variant>
 #include <vector>
 #include <memory>
 #include <atomic>
-#include <mutex>
+#include <ranges>
 #include <type_traits>
 
 #include <vega/Promise.h> 
@@ -32,31 +35,32 @@ struct promise_traits<Promise<T>> {
 };
 
 // Trait to deduce the "Unwrapped" type from any argument
+// (Wrapped in std::type_identity, so T doesn't need to be default constructible)
 // (Works for T, Promise<T>, Callable->T, Callable->Promise<T>)
 template <typename T>
 auto get_unwrapped_type() {
     using T_decay = std::remove_cvref_t<T>;
     
     if constexpr (promise_traits<T_decay>::is_promise) {
-        return typename promise_traits<T_decay>::value_type{};
+        return std::type_identity<typename promise_traits<T_decay>::value_type> {};
     }
     else if constexpr (std::is_invocable_v<T_decay>) {
         using Ret = std::invoke_result_t<T_decay>;
         using Ret_decay = std::remove_cvref_t<Ret>;
         
         if constexpr (promise_traits<Ret_decay>::is_promise) {
-            return typename promise_traits<Ret_decay>::value_type{};
+            return std::type_identity<typename promise_traits<Ret_decay>::value_type> {};
         } else {
-            return Ret{};
+            return std::type_identity<Ret> {};
         }
     }
     else {
-        return T_decay{};
+        return std::type_identity<T_decay> {};
     }
 }
 
 template <typename T>
-using unwrap_t = decltype(get_unwrapped_type<T>());
+using unwrap_t = typename decltype(get_unwrapped_type<T>())::type;
 
 // Normalizer: Converts Value/Callable/Promise -> Promise<T>
 template <typename T>
@@ -91,6 +95,204 @@ auto to_promise(T&& arg) {
 }
 
 
+
+/**
+ * Countdown and first-rejection bookkeeping shared by the promiseAll states below.
+ * The state is the state of the returned promise at the same time, so the countdown
+ * and the result slots live next to the result itself.
+ *
+ * Derived must provide `complete()`, which resolves the result from the filled slots.
+ */
+template <typename ResultT, typename Derived>
+class AllStateBase : public PromiseState<ResultT> {
+public:
+    /**
+     * Pending inputs, plus one held while inputs are still being attached.
+     */
+    std::atomic<size_t> remaining {1};
+    std::atomic<bool> rejected {false};
+
+    /**
+     * Keeps this state alive until every input settles.
+     */
+    std::shared_ptr<PromiseStateBase> self;
+
+
+    void fail(std::exception_ptr e) {
+        bool expected = false;
+        if (rejected.compare_exchange_strong(expected, true))
+            this->reject(e);
+    }
+
+
+    void countDown() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        auto keepAlive = std::move(self);
+
+        if (!rejected.load(std::memory_order_relaxed))
+            static_cast<Derived*>(this)->complete();
+    }
+
+
+    /**
+     * Consumes an input that has already settled, without attaching anything to it.
+     * Returns false if the input is still pending.
+     */
+    template <typename T, typename Store>
+    bool tryTakeReady(Promise<T>& p, Store&& store) {
+        auto awaiter = p.operator co_await();
+        if (!awaiter.await_ready())
+            return false;
+
+        try {
+            if constexpr (std::is_void_v<T>) {
+                awaiter.await_resume();
+                store();
+            }
+            else {
+                store(awaiter.await_resume());
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+
+        return true;
+    }
+};
+
+
+/**
+ * Shared block of promiseAll over a range.
+ *
+ * Every input owns one preallocated slot, so slots are written without locking, and the
+ * last input to settle (found by an atomic countdown) resolves the result.
+ */
+template <typename T>
+class RangeAllState
+    : public AllStateBase<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>, RangeAllState<T>> {
+public:
+    struct Empty {};
+
+    std::vector<std::shared_ptr<PromiseState<T>>> sources;
+    std::conditional_t<std::is_void_v<T>, Empty, std::vector<T>> values;
+
+
+    /**
+     * Slots must be allocated before any input is attached, since inputs may
+     * settle on other threads while the rest are still being attached.
+     */
+    void allocate(size_t n) {
+        sources.resize(n);
+        if constexpr (!std::is_void_v<T>)
+            values.resize(n);
+    }
+
+
+    void complete() {
+        if constexpr (std::is_void_v<T>)
+            this->resolve();
+        else
+            this->resolve(std::move(values));
+    }
+
+
+    void add(size_t i, Promise<T> p) {
+        bool ready = this->tryTakeReady(p, [this, i] (auto&&... v) {
+            if constexpr (sizeof...(v) > 0)
+                values[i] = std::move(v...);
+        });
+
+        if (ready)
+            return;
+
+        sources[i] = p.state;
+        this->remaining.fetch_add(1, std::memory_order_relaxed);
+
+        p.state->addContinuation([all = this, i] () {
+            auto* src = all->sources[i].get();
+
+            if (src->exception) {
+                all->fail(src->exception);
+            }
+            else if constexpr (!std::is_void_v<T>) {
+                all->values[i] = std::move(*src->value);
+            }
+
+            all->countDown();
+        });
+    }
+};
+
+
+/**
+ * Type stored in a promiseAllTuple result for a Promise<T> input.
+ */
+template <typename T>
+using tuple_slot_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+
+/**
+ * Shared block of promiseAllTuple. Sources and result slots are sized at compile time,
+ * so the whole operation needs this one allocation.
+ */
+template <typename... Ts>
+class TupleAllState
+    : public AllStateBase<std::tuple<tuple_slot_t<Ts>...>, TupleAllState<Ts...>> {
+public:
+    using ResultT = std::tuple<tuple_slot_t<Ts>...>;
+
+    std::tuple<std::shared_ptr<PromiseState<Ts>>...> sources;
+
+    /**
+     * Values don't need to be default constructible, so slots start out empty.
+     */
+    std::tuple<std::optional<tuple_slot_t<Ts>>...> values;
+
+
+    void complete() {
+        [this] <size_t... I> (std::index_sequence<I...>) {
+            this->resolve(ResultT(std::move(*std::get<I>(values))...));
+        } (std::index_sequence_for<Ts...> {});
+    }
+
+
+    template <size_t I, typename T>
+    void add(Promise<T> p) {
+        bool ready = this->tryTakeReady(p, [this] (auto&&... v) {
+            if constexpr (sizeof...(v) > 0)
+                std::get<I>(values).emplace(std::move(v...));
+            else
+                std::get<I>(values).emplace();
+        });
+
+        if (ready)
+            return;
+
+        std::get<I>(sources) = p.state;
+        this->remaining.fetch_add(1, std::memory_order_relaxed);
+
+        p.state->addContinuation([all = this] () {
+            auto* src = std::get<I>(all->sources).get();
+
+            if (src->exception) {
+                all->fail(src->exception);
+            }
+            else if constexpr (std::is_void_v<T>) {
+                std::get<I>(all->values).emplace();
+            }
+            else {
+                std::get<I>(all->values).emplace(std::move(*src->value));
+            }
+
+            all->countDown();
+        });
+    }
+};
+
+
 } // namespace vega::__promise_all_details
 
 
@@ -132,7 +334,6 @@ auto promiseAll(Args&&... args) {
     struct State {
         std::atomic<size_t> remaining{N};
         std::atomic<bool> rejected{false};
-        std::mutex mtx; // Protects vector writes
         
         // Storage: Use std::vector if homogeneous, else empty struct
         struct Empty {};
@@ -153,7 +354,8 @@ auto promiseAll(Args&&... args) {
         auto p = to_promise(std::forward<decltype(arg)>(arg));
         
         // Attach continuation
-        p.state->addContinuation([p_state = p.state, state, i, res_state = result.state]() {
+        auto p_state = p.getState();
+        p_state->addContinuation([p_state, state, i, res_state = result.state]() {
             
             // Handle Rejection
             if (p_state->exception) {
@@ -170,14 +372,15 @@ auto promiseAll(Args&&... args) {
 
             // Handle Success Value
             if constexpr (IsVector) {
-                // p is guaranteed to be Promise<FirstT> here, so .value exists
-                std::lock_guard lock(state->mtx);
+                // p is guaranteed to be Promise<FirstT> here, so .value exists.
+                // Every continuation owns a distinct slot, so no lock is needed. The acq_rel
+                // countdown below publishes the slot to whoever resolves the result.
                 state->values[i] = std::move(*p_state->value);
             }
 
             // Decrement Counter
             // fetch_sub returns the value BEFORE decrement. So if it returns 1, it is now 0.
-            if (state->remaining.fetch_sub(1) == 1) {
+            if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
                 if (!state->rejected) {
                     if constexpr (IsVector) {
                         res_state->resolve(std::move(state->values));
@@ -196,6 +399,81 @@ auto promiseAll(Args&&... args) {
 }
 
 
+/**
+ * promiseAll over a runtime-sized range of Promise<T>, like std::vector<Promise<T>>.
+ *
+ * Resolves to std::vector<T> in input order (T must be default constructible),
+ * or to void for Promise<void> inputs. Rejects with the first rejection.
+ */
+template <std::ranges::input_range R>
+requires __promise_all_details::promise_traits<std::remove_cvref_t<std::ranges::range_value_t<R>>>::is_promise
+auto promiseAll(R&& range) {
+    using namespace vega::__promise_all_details;
+    using T = typename promise_traits<std::remove_cvref_t<std::ranges::range_value_t<R>>>::value_type;
+    using ResultT = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+    if constexpr (!std::ranges::sized_range<R>) {
+        // Slots are allocated up front, so we need to know the count first.
+        std::vector<Promise<T>> promises;
+        for (auto&& p : range) {
+            if constexpr (std::is_lvalue_reference_v<R>)
+                promises.push_back(p);
+            else
+                promises.push_back(std::move(p));
+        }
+
+        return promiseAll(std::move(promises));
+    }
+    else {
+        auto all = std::make_shared<RangeAllState<T>>();
+        all->scheduler = &getCurrentScheduler();
+        all->self = all;
+        all->allocate(std::ranges::size(range));
+
+        size_t i = 0;
+        for (auto&& p : range) {
+            if constexpr (std::is_lvalue_reference_v<R>)
+                all->add(i++, p);
+            else
+                all->add(i++, std::move(p));
+        }
+
+        // Drop the count held while attaching. Resolves right away if nothing is pending.
+        all->countDown();
+
+        return Promise<ResultT>(std::shared_ptr<PromiseState<ResultT>>(std::move(all)));
+    }
+}
+
+
+/**
+ * Like promiseAll, but arguments may have different types, and the results are kept:
+ * resolves to std::tuple with one element per argument, in argument order.
+ *
+ * Arguments are normalized the same way as in promiseAll (values, callables, promises).
+ * Promise<void> inputs become std::monostate in the tuple.
+ */
+template <typename... Args>
+auto promiseAllTuple(Args&&... args) {
+    using namespace vega::__promise_all_details;
+    using State = TupleAllState<unwrap_t<Args>...>;
+    using ResultT = typename State::ResultT;
+
+    auto all = std::make_shared<State>();
+    all->scheduler = &getCurrentScheduler();
+    all->self = all;
+
+    [&] <size_t... I> (std::index_sequence<I...>) {
+        (all->template add<I>(to_promise(std::forward<Args>(args))), ...);
+    } (std::index_sequence_for<Args...> {});
+
+    // Drop the count held while attaching. Resolves right away if nothing is pending.
+    all->countDown();
+
+    return Promise<ResultT>(std::shared_ptr<PromiseState<ResultT>>(std::move(all)));
+}
+
+
 }  // namespace vega
 
 
@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <vega/Promise.h>
+#include <vega/PromiseAll.h>
+
+
+namespace vega {
+
+
+/**
+ * Rejection of promiseAny when every input rejected. Holds the rejections in input order.
+ */
+struct AggregateError : std::runtime_error {
+    std::vector<std::exception_ptr> errors;
+
+    AggregateError(std::vector<std::exception_ptr> errors)
+        : std::runtime_error("all promises were rejected"), errors(std::move(errors)) {}
+};
+
+
+}  // namespace vega
+
+
+/**
+ * namespace vega::__promise_race_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace vega::__promise_race_details {
+
+
+/**
+ * Result of racing promises of types Ts: T if they all are Promise<T>,
+ * otherwise a std::variant indexed by argument position.
+ */
+template <typename... Ts>
+struct race_result {
+    static constexpr bool Same = sizeof...(Ts) > 0
+        && (std::is_same_v<std::tuple_element_t<0, std::tuple<Ts...>>, Ts> && ...);
+
+    using type = typename std::conditional_t<
+        Same || sizeof...(Ts) == 0,
+        std::tuple_element<0, std::tuple<Ts..., void>>,
+        std::type_identity<std::variant<__promise_all_details::tuple_slot_t<Ts>...>>
+    >::type;
+};
+
+
+/**
+ * Shared block of promiseRace (Any = false) and promiseAny (Any = true).
+ * It is the state of the returned promise at the same time.
+ *
+ * The first input to settle (or to fulfill, for promiseAny) settles the result,
+ * and every other input is cancelled right away.
+ */
+template <typename ResultT, bool Any>
+class RaceState : public PromiseState<ResultT> {
+public:
+    std::vector<std::shared_ptr<PromiseStateBase>> sources;
+
+    /**
+     * Rejections so far, in input order. Only used by promiseAny.
+     */
+    std::vector<std::exception_ptr> errors;
+
+    /**
+     * Attached inputs that haven't settled, plus one held while inputs are still being attached.
+     */
+    std::atomic<size_t> remaining {1};
+    std::atomic<bool> won {false};
+    std::atomic<bool> attached {false};
+
+    /**
+     * Keeps this state alive until every attached input settles.
+     */
+    std::shared_ptr<PromiseStateBase> self;
+
+
+    RaceState() {
+        // Cancelling the race cancels every input.
+        this->onCancel([this] () { cancelOthers(SIZE_MAX); });
+    }
+
+
+    void allocate(size_t n) {
+        sources.resize(n);
+        if constexpr (Any)
+            errors.resize(n);
+    }
+
+
+    /**
+     * Cancel the other inputs and settle the result with [settle] (), if nobody did yet.
+     */
+    template <typename F>
+    void win(size_t i, F&& settle) {
+        bool expected = false;
+        if (!won.compare_exchange_strong(expected, true))
+            return;
+
+        // Cancelled inputs may settle synchronously and release `self`.
+        auto keepAlive = this->getPtr();
+
+        // Losers are cancelled before settling, so they have stopped by the time the
+        // awaiting coroutine resumes. Inputs still being attached are cancelled in `finishAttach`.
+        if (attached.load(std::memory_order_acquire))
+            cancelOthers(i);
+
+        settle();
+    }
+
+
+    void fail(size_t i, std::exception_ptr e) {
+        if constexpr (Any)
+            errors[i] = e;
+        else
+            win(i, [this, e] () { this->reject(e); });
+    }
+
+
+    void cancelOthers(size_t winner) {
+        for (size_t i = 0; i < sources.size(); i++) {
+            if (i != winner && sources[i])
+                sources[i]->cancel();
+        }
+    }
+
+
+    void countDown() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        auto keepAlive = std::move(self);
+
+        if constexpr (Any) {
+            win(SIZE_MAX, [this] () {
+                this->reject(std::make_exception_ptr(AggregateError(std::move(errors))));
+            });
+        }
+    }
+
+
+    /**
+     * Attach input [i]. [Make] builds ResultT from the input's value (it must be a
+     * captureless lambda type, so the continuation only captures this and i).
+     */
+    template <typename Make, typename T>
+    void add(size_t i, Promise<T> p) {
+        auto awaiter = p.operator co_await();
+
+        if (awaiter.await_ready()) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    awaiter.await_resume();
+                    win(i, [this] () { settleWith<Make>(); });
+                }
+                else {
+                    T&& value = awaiter.await_resume();
+                    win(i, [this, &value] () { settleWith<Make>(std::move(value)); });
+                }
+            }
+            catch (...) {
+                fail(i, std::current_exception());
+            }
+            return;
+        }
+
+        if (won.load(std::memory_order_acquire)) {
+            p.state->cancel();
+            return;
+        }
+
+        sources[i] = p.state;
+        remaining.fetch_add(1, std::memory_order_relaxed);
+
+        p.state->addContinuation([all = this, i] () {
+            auto* src = static_cast<PromiseState<T>*>(all->sources[i].get());
+
+            if (src->exception) {
+                all->fail(i, src->exception);
+            }
+            else if constexpr (std::is_void_v<T>) {
+                all->win(i, [all] () { all->template settleWith<Make>(); });
+            }
+            else {
+                all->win(i, [all, src] () { all->template settleWith<Make>(std::move(*src->value)); });
+            }
+
+            all->countDown();
+        });
+    }
+
+
+    /**
+     * Drop the count held while attaching, and cancel the losers if someone won meanwhile.
+     */
+    void finishAttach() {
+        attached.store(true, std::memory_order_release);
+
+        if (won.load(std::memory_order_acquire))
+            cancelOthers(SIZE_MAX);
+
+        countDown();
+    }
+
+
+    template <typename Make, typename... V>
+    void settleWith(V&&... value) {
+        if constexpr (std::is_void_v<ResultT>)
+            this->resolve();
+        else
+            this->resolve(Make {} (std::forward<V>(value)...));
+    }
+};
+
+
+template <typename ResultT, bool Any, typename... Args>
+Promise<ResultT> raceVariadic(Args&&... args) {
+    using namespace vega::__promise_all_details;
+    using State = RaceState<ResultT, Any>;
+
+    auto all = std::make_shared<State>();
+    all->scheduler = &getCurrentScheduler();
+    all->self = all;
+    all->allocate(sizeof...(Args));
+
+    [&] <size_t... I> (std::index_sequence<I...>) {
+        auto add = [&] <size_t Index> (auto&& p) {
+            using T = typename std::remove_cvref_t<decltype(p)>::value_type;
+
+            auto make = [] (auto&&... v) -> ResultT {
+                if constexpr (race_result<unwrap_t<Args>...>::Same)
+                    return ResultT(std::forward<decltype(v)>(v)...);
+                else if constexpr (std::is_void_v<T>)
+                    return ResultT(std::in_place_index<Index>);
+                else
+                    return ResultT(std::in_place_index<Index>, std::forward<decltype(v)>(v)...);
+            };
+
+            all->template add<decltype(make)>(Index, std::forward<decltype(p)>(p));
+        };
+
+        (add.template operator()<I>(to_promise(std::forward<Args>(args))), ...);
+    } (std::index_sequence_for<Args...> {});
+
+    all->finishAttach();
+
+    return Promise<ResultT>(std::shared_ptr<PromiseState<ResultT>>(std::move(all)));
+}
+
+
+template <bool Any, std::ranges::input_range R>
+auto raceRange(R&& range) {
+    using namespace vega::__promise_all_details;
+    using T = typename promise_traits<std::remove_cvref_t<std::ranges::range_value_t<R>>>::value_type;
+
+    if constexpr (!std::ranges::sized_range<R>) {
+        std::vector<Promise<T>> promises;
+        for (auto&& p : range) {
+            if constexpr (std::is_lvalue_reference_v<R>)
+                promises.push_back(p);
+            else
+                promises.push_back(std::move(p));
+        }
+
+        return raceRange<Any>(std::move(promises));
+    }
+    else {
+        using State = RaceState<T, Any>;
+
+        auto make = [] (auto&&... v) -> T {
+            if constexpr (!std::is_void_v<T>)
+                return T(std::forward<decltype(v)>(v)...);
+        };
+
+        auto all = std::make_shared<State>();
+        all->scheduler = &getCurrentScheduler();
+        all->self = all;
+        all->allocate(std::ranges::size(range));
+
+        size_t i = 0;
+        for (auto&& p : range) {
+            if constexpr (std::is_lvalue_reference_v<R>)
+                all->template add<decltype(make)>(i++, p);
+            else
+                all->template add<decltype(make)>(i++, std::move(p));
+        }
+
+        all->finishAttach();
+
+        return Promise<T>(std::shared_ptr<PromiseState<T>>(std::move(all)));
+    }
+}
+
+
+}  // namespace vega::__promise_race_details
+
+
+namespace vega {
+
+
+/**
+ * Settle with whichever input settles first (fulfilled or rejected), like JavaScript's
+ * Promise.race. The other inputs are cancelled as soon as the winner settles, so their
+ * pending io_uring operations are cancelled and their coroutines stop at the next co_await.
+ *
+ * Arguments may be values, callables or promises, like in promiseAll.
+ * Resolves to T if every argument resolves to T, otherwise to a std::variant indexed
+ * by argument position (Promise<void> maps to std::monostate).
+ *
+ * With no arguments, the returned promise never settles.
+ */
+template <typename... Args>
+auto promiseRace(Args&&... args) {
+    using ResultT = typename __promise_race_details::race_result<__promise_all_details::unwrap_t<Args>...>::type;
+    return __promise_race_details::raceVariadic<ResultT, false>(std::forward<Args>(args)...);
+}
+
+
+/**
+ * Settle with whichever input fulfills first, like JavaScript's Promise.any.
+ * If every input rejects, rejects with AggregateError. Losers are cancelled like in promiseRace.
+ */
+template <typename... Args>
+auto promiseAny(Args&&... args) {
+    using ResultT = typename __promise_race_details::race_result<__promise_all_details::unwrap_t<Args>...>::type;
+    return __promise_race_details::raceVariadic<ResultT, true>(std::forward<Args>(args)...);
+}
+
+
+/**
+ * promiseRace over a runtime-sized range of Promise<T>.
+ */
+template <std::ranges::input_range R>
+requires __promise_all_details::promise_traits<std::remove_cvref_t<std::ranges::range_value_t<R>>>::is_promise
+auto promiseRace(R&& range) {
+    return __promise_race_details::raceRange<false>(std::forward<R>(range));
+}
+
+
+/**
+ * promiseAny over a runtime-sized range of Promise<T>. An empty range rejects with AggregateError.
+ */
+template <std::ranges::input_range R>
+requires __promise_all_details::promise_traits<std::remove_cvref_t<std::ranges::range_value_t<R>>>::is_promise
+auto promiseAny(R&& range) {
+    return __promise_race_details::raceRange<true>(std::forward<R>(range));
+}
+
+
+}  // namespace vega
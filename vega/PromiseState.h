@@ -2,11 +2,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <exception>
 #include <optional>
 #include <vector>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 
 
 namespace vega {
@@ -19,6 +21,14 @@ class Scheduler;
 enum class PromiseStatus { Pending, Fulfilled, Rejected };
 
 
+/**
+ * Thrown into (or used to reject) promises whose work was cancelled.
+ */
+struct CancelledError : std::runtime_error {
+    CancelledError() : std::runtime_error("promise cancelled") {}
+};
+
+
 class PromiseStateBase : public std::enable_shared_from_this<PromiseStateBase> {
 protected:
 
@@ -28,7 +38,8 @@ protected:
 public:
 
     static std::shared_ptr<PromiseStateBase> create() {
-        return std::make_shared<PromiseStateBase>(PromiseStateBase{});
+        struct Created : PromiseStateBase {};
+        return std::make_shared<Created>();
     }
 
     template <typename T = PromiseStateBase>
@@ -45,7 +56,7 @@ public:
 
 public:
 
-    PromiseStatus status = PromiseStatus::Pending;
+    std::atomic<PromiseStatus> status = PromiseStatus::Pending;
     std::exception_ptr exception;
 
     /**
@@ -58,18 +69,174 @@ public:
     
 protected:
 
+    /**
+     * Most promises are awaited exactly once, so the first continuation is kept
+     * inline and only the rest go to `continuations`.
+     */
+    std::function<void()> continuation;
     std::vector<std::function<void()>> continuations;
 
+    /**
+     * How the underlying work stops (e.g. cancelling an io_uring operation). See `onCancel`.
+     */
+    std::function<void()> cancelHook;
+
+    /**
+     * Guards settling against continuations being added at the same time. Promises may be
+     * awaited on one worker thread while being settled on another, and without this a
+     * continuation added right as the promise settles could be lost.
+     */
+    std::atomic_flag settleLock;
+
+    void lockSettle() {
+        while (settleLock.test_and_set(std::memory_order_acquire)) {
+            while (settleLock.test(std::memory_order_relaxed));
+        }
+    }
+
+    void unlockSettle() {
+        settleLock.clear(std::memory_order_release);
+    }
+
+
+    /**
+     * Mark this promise settled with [outcome] (), which stores the value or exception.
+     * Returns false if it already settled.
+     */
+    template <typename F>
+    bool settle(PromiseStatus to, F&& outcome) {
+        lockSettle();
+
+        if (status != PromiseStatus::Pending) {
+            unlockSettle();
+            return false;
+        }
+
+        outcome();
+        status = to;
+        unlockSettle();
+
+        return true;
+    }
+
+    /**
+     * The promise this one is currently waiting for (what a coroutine is suspended on,
+     * or the source of a `map`). Cancellation is forwarded to it. Guarded by `settleLock`,
+     * as `cancel` may come from another thread.
+     */
+    std::weak_ptr<PromiseStateBase> awaiting;
+
 public:
 
+    /**
+     * Set once `cancel` is called. May be set from another thread.
+     */
+    std::atomic<bool> cancelled {false};
+
+
+    /**
+     * Set what this promise waits for (see `awaiting`).
+     *
+     * @return Whether it was cancelled already (in which case [child] isn't cancelled for it).
+     */
+    bool setAwaiting(std::weak_ptr<PromiseStateBase> child) {
+        lockSettle();
+        awaiting = std::move(child);
+        bool wasCancelled = cancelled;
+        unlockSettle();
+
+        return wasCancelled;
+    }
+
+    void clearAwaiting() {
+        lockSettle();
+        awaiting.reset();
+        unlockSettle();
+    }
+
+
+    /**
+     * Register what to do when this promise is cancelled. Runs right away if it already was.
+     */
+    void onCancel(std::function<void()> hook) {
+        lockSettle();
+        if (!cancelled) {
+            cancelHook = std::move(hook);
+            unlockSettle();
+            return;
+        }
+        unlockSettle();
+
+        hook();
+    }
+
+
+    /**
+     * Drop the cancel hook, once the work it would stop is over.
+     */
+    void clearCancelHook() {
+        std::function<void()> hook;
+
+        lockSettle();
+        hook.swap(cancelHook);
+        unlockSettle();
+    }
+
+
+    /**
+     * Ask the work behind this promise to stop. Cancellation is cooperative:
+     * it is forwarded to the awaited promise and to the cancel hook, and a coroutine
+     * that is cancelled throws CancelledError from its next co_await that suspends.
+     *
+     * Does nothing if the promise already settled.
+     */
+    void cancel() {
+        // Checked under the lock, so `cancelled` is only ever set on a promise that hasn't settled.
+        lockSettle();
+        if (status != PromiseStatus::Pending || cancelled) {
+            unlockSettle();
+            return;
+        }
+
+        cancelled = true;
+        auto child = awaiting.lock();
+        std::function<void()> hook;
+        hook.swap(cancelHook);
+        unlockSettle();
+
+        // Outside the lock: both may settle promises, this one included.
+        if (child)
+            child->cancel();
+
+        if (hook)
+            hook();
+    }
+
+
     void addContinuation(std::function<void()> cont) {
-        if (status != PromiseStatus::Pending)
+        lockSettle();
+
+        if (status != PromiseStatus::Pending) {
+            unlockSettle();
             cont();
+            return;
+        }
+
+        if (!continuation)
+            continuation = std::move(cont);
         else
             continuations.push_back(std::move(cont));
+
+        unlockSettle();
     }
 
     void resumeContinuations() {
+        if (continuation) {
+            auto cont = std::move(continuation);
+            continuation = nullptr;
+            cont();
+        }
+
         for (auto& cont : continuations) {
             cont();
         }
@@ -80,15 +247,16 @@ public:
     void resumeContinuationsOnScheduler(Scheduler* scheduler = nullptr);
 
 
-    void reject(std::exception_ptr e) {
-        if (status != PromiseStatus::Pending) {
-            return;
+    /**
+     * Returns false if the promise already settled (and nothing happens).
+     */
+    bool reject(std::exception_ptr e) {
+        if (!settle(PromiseStatus::Rejected, [this, &e] () { exception = e; })) {
+            return false;
         }
-
-        exception = e;
-        status = PromiseStatus::Rejected;
         
         resumeContinuationsOnScheduler();
+        return true;
     }
 };
 
@@ -100,22 +268,24 @@ protected:
 
 public:
     static std::shared_ptr<PromiseState<T>> create() {
-        return std::make_shared<PromiseState<T>>(PromiseState<T>{});
+        struct Created : PromiseState<T> {};
+        return std::make_shared<Created>();
     }
 
 
     std::optional<T> value;
 
 
-    void resolve(T v) {
-        if (status != PromiseStatus::Pending) {
-            return;
+    /**
+     * Returns false if the promise already settled (and nothing happens).
+     */
+    bool resolve(T v) {
+        if (!settle(PromiseStatus::Fulfilled, [this, &v] () { value = std::move(v); })) {
+            return false;
         }
-
-        value = std::move(v);
-        status = PromiseStatus::Fulfilled;
         
         resumeContinuationsOnScheduler();
+        return true;
     }
 };
 
@@ -128,17 +298,20 @@ protected:
 
 public:
     static std::shared_ptr<PromiseState<void>> create() {
-        return std::make_shared<PromiseState<void>>(PromiseState<void>{});
+        struct Created : PromiseState<void> {};
+        return std::make_shared<Created>();
     }
 
-    void resolve() {
-        if (status != PromiseStatus::Pending) {
-            return;
+    /**
+     * Returns false if the promise already settled (and nothing happens).
+     */
+    bool resolve() {
+        if (!settle(PromiseStatus::Fulfilled, [] () {})) {
+            return false;
         }
-
-        status = PromiseStatus::Fulfilled;
         
         resumeContinuationsOnScheduler();
+        return true;
     }
 };
 
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+#include <vega/Scheduler.h>
+
+
+namespace vega {
+
+
+/**
+ * Token bucket rate limiter for coroutines:
+ *
+ *     AsyncRateLimiter limiter(1000, 100);  // 1000 tokens/s, bursts of up to 100.
+ *
+ *     co_await limiter.acquire(bytes.size());
+ *     co_await socket.write(bytes);
+ *
+ * While tokens are available (and nobody waits), `acquire` takes them and returns a ready
+ * promise: no clock read, no timer and no allocation. The bucket is only refilled from the
+ * elapsed time when it runs short, so the clock is read at most once per slow acquire.
+ *
+ * Callers that have to wait queue up in FIFO order, and one Scheduler timer at a time is
+ * armed for the head of the queue. When it fires, every waiter the refilled bucket covers
+ * is woken at once, so overhead per waiter stays constant however long the queue gets.
+ *
+ * A cancelled acquire leaves the queue without taking tokens. Destroying the limiter
+ * rejects the acquires still waiting with CancelledError.
+ */
+class AsyncRateLimiter {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    struct Waiter {
+        double tokens;
+        std::shared_ptr<PromiseState<void>> state;
+    };
+
+    /**
+     * Shared with the timer, which may fire after the limiter is gone.
+     */
+    struct Core {
+        std::mutex lock;
+
+        double rate;
+        double burst;
+        double tokens;
+
+        /**
+         * When `tokens` was last brought up to date.
+         */
+        Clock::time_point refilledAt;
+
+        std::deque<Waiter> waiters;
+
+        /**
+         * Armed timer, if any (at most one).
+         */
+        std::shared_ptr<PromiseState<void>> timer;
+
+
+        /**
+         * Must hold `lock`.
+         */
+        void refill(Clock::time_point now) {
+            std::chrono::duration<double> elapsed = now - refilledAt;
+            tokens = std::min(burst, tokens + elapsed.count() * rate);
+            refilledAt = now;
+        }
+
+
+        /**
+         * Drop cancelled waiters at the head of the queue. Must hold `lock`.
+         */
+        void skipSettled() {
+            while (!waiters.empty() && waiters.front().state->status != PromiseStatus::Pending)
+                waiters.pop_front();
+        }
+
+
+        /**
+         * Arm the timer for when the head waiter's tokens will be there. Must hold `lock`.
+         */
+        void arm(std::shared_ptr<Core> self, Scheduler& scheduler) {
+            std::chrono::duration<double> wait { (waiters.front().tokens - tokens) / rate };
+
+            timer = scheduler.delay(std::chrono::ceil<Clock::duration>(wait)).getState();
+            timer->addContinuation([weakSelf = std::weak_ptr<Core>(self), timer = timer.get(), &scheduler] () {
+                if (timer->status != PromiseStatus::Fulfilled)
+                    return;
+
+                if (auto core = weakSelf.lock())
+                    core->wake(core, scheduler);
+            });
+        }
+
+
+        void wake(const std::shared_ptr<Core>& self, Scheduler& scheduler) {
+            std::vector<std::shared_ptr<PromiseState<void>>> ready;
+            {
+                std::lock_guard _l {lock};
+
+                timer = nullptr;
+                refill(Clock::now());
+
+                skipSettled();
+                while (!waiters.empty() && waiters.front().tokens <= tokens) {
+                    tokens -= waiters.front().tokens;
+                    ready.push_back(std::move(waiters.front().state));
+                    waiters.pop_front();
+                    skipSettled();
+                }
+
+                if (!waiters.empty())
+                    arm(self, scheduler);
+            }
+
+            for (auto& state : ready)
+                state->resolve();
+        }
+    };
+
+    std::shared_ptr<Core> core_ = std::make_shared<Core>();
+
+
+public:
+    /**
+     * @param rate Tokens added per second.
+     * @param burst Bucket size: most tokens that can be taken at once. The bucket starts full.
+     */
+    AsyncRateLimiter(double rate, double burst) {
+        if (rate <= 0 || burst <= 0)
+            throw std::invalid_argument("AsyncRateLimiter: rate and burst must be positive");
+
+        core_->rate = rate;
+        core_->burst = burst;
+        core_->tokens = burst;
+        core_->refilledAt = Clock::now();
+    }
+
+    AsyncRateLimiter(const AsyncRateLimiter&) = delete;
+    AsyncRateLimiter& operator = (const AsyncRateLimiter&) = delete;
+
+    /**
+     * Cancels the timer, so it doesn't keep the scheduler busy, and rejects pending acquires
+     * with CancelledError.
+     */
+    ~AsyncRateLimiter() {
+        std::shared_ptr<PromiseState<void>> timer;
+        std::deque<Waiter> waiters;
+        {
+            std::lock_guard _l {core_->lock};
+            timer = std::move(core_->timer);
+            waiters.swap(core_->waiters);
+        }
+
+        if (timer)
+            timer->cancel();
+
+        for (auto& waiter : waiters)
+            waiter.state->reject(std::make_exception_ptr(CancelledError()));
+    }
+
+
+    /**
+     * Take [n] tokens if they are available and nobody is waiting, without waiting.
+     */
+    bool tryAcquire(double n = 1) {
+        std::lock_guard _l {core_->lock};
+        core_->skipSettled();
+        if (!core_->waiters.empty())
+            return false;
+
+        if (core_->tokens < n)
+            core_->refill(Clock::now());
+
+        if (core_->tokens < n)
+            return false;
+
+        core_->tokens -= n;
+        return true;
+    }
+
+
+    /**
+     * Take [n] tokens, waiting (behind earlier waiters) until they are available.
+     * Rejects with std::invalid_argument if [n] is more than the bucket holds.
+     */
+    Promise<void> acquire(double n = 1) {
+        if (n > core_->burst)
+            return Promise<void>::reject(std::invalid_argument("AsyncRateLimiter: acquiring more than burst size"));
+
+        std::lock_guard _l {core_->lock};
+        core_->skipSettled();
+
+        if (core_->waiters.empty()) {
+            if (core_->tokens < n)
+                core_->refill(Clock::now());
+
+            if (core_->tokens >= n) {
+                core_->tokens -= n;
+                return Promise<void>::resolve();
+            }
+        }
+
+        Promise<void> ret;
+        auto& scheduler = getCurrentScheduler();
+        ret.state->scheduler = &scheduler;
+
+        ret.state->onCancel([state = ret.state.get()] () {
+            state->reject(std::make_exception_ptr(CancelledError()));
+        });
+
+        core_->waiters.push_back({ n, ret.state });
+
+        if (!core_->timer)
+            core_->arm(core_, scheduler);
+
+        return ret;
+    }
+
+
+    /**
+     * Tokens in the bucket as of the last refill. For diagnostics only.
+     */
+    double available() {
+        std::lock_guard _l {core_->lock};
+        core_->refill(Clock::now());
+        return core_->tokens;
+    }
+
+    /**
+     * Callers waiting for tokens (including cancelled ones not dropped yet).
+     */
+    size_t waiting() {
+        std::lock_guard _l {core_->lock};
+        return core_->waiters.size();
+    }
+};
+
+
+}  // namespace vega
@@ -3,6 +3,14 @@
 #include <vega/Scheduler.h>
 #include <vega/io/IoUring.h>
 
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace vega {
 
 
@@ -16,8 +24,18 @@ static thread_local Scheduler* currentScheduler = nullptr;
  */
 static thread_local size_t workerThreadId = SIZE_MAX;
 
+/**
+ * Tasks queued by `addTaskAfterCurrent` on this thread.
+ */
+static thread_local std::vector<std::function<void()>> tasksAfterCurrent;
+
 #if defined(__linux__)
 static thread_local std::unique_ptr<io::IoUring> threadIoUring;
+
+/**
+ * The thread's timer slack before `idleWait` lowered it, or -1 while it isn't lowered.
+ */
+static thread_local long savedTimerSlack = -1;
 #endif
 
 
@@ -58,6 +76,27 @@ Scheduler* Scheduler::setCurrent(Scheduler* scheduler) {
 }
 
 
+static void __runTasksAfterCurrent() {
+    while (!tasksAfterCurrent.empty()) {
+        auto tasks = std::move(tasksAfterCurrent);
+        tasksAfterCurrent.clear();
+
+        for (auto& task : tasks)
+            task();
+    }
+}
+
+
+void Scheduler::addTaskAfterCurrent(Task task) {
+    if (currentScheduler != this) {
+        this->addTask(std::move(task));
+        return;
+    }
+
+    tasksAfterCurrent.push_back(std::move(task));
+}
+
+
 bool Scheduler::isCurrentThreadWorker() const {
     return workerThreadId != SIZE_MAX;
 }
@@ -115,14 +154,22 @@ void Scheduler::workerThreadMain(size_t workerId) {
         bool semaphoreAcquired = taskSemaphore.try_acquire();
 
         auto ioUringTaskResolved = pollIoUringIfInitialized();
+        __runTasksAfterCurrent();
         
         if (stopWorkers)
             break;
 
         if (!semaphoreAcquired) {
-            if (!ioUringTaskResolved)
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
-            continue;
+            if (ioUringTaskResolved)
+                continue;
+
+            // Idle: wait for a task, but look at io_uring again within 5 ms.
+            // Unlike sleeping, this wakes up as soon as a task is queued.
+            if (!taskSemaphore.try_acquire_for(std::chrono::milliseconds(5)))
+                continue;
+
+            if (stopWorkers)
+                break;
         }
 
         std::optional<Task> task;
@@ -138,6 +185,7 @@ void Scheduler::workerThreadMain(size_t workerId) {
             
         activeWorkers++;
         task.value()();  // note: if task throws, it will destroy the whole worker thread.
+        __runTasksAfterCurrent();
         activeWorkers--;
     }
 
@@ -147,6 +195,79 @@ void Scheduler::workerThreadMain(size_t workerId) {
 }
 
 
+void Scheduler::restoreTimerSlack() {
+#if defined(__linux__)
+    if (savedTimerSlack == -1)
+        return;
+
+    prctl(PR_SET_TIMERSLACK, (unsigned long) savedTimerSlack, 0, 0, 0);
+    savedTimerSlack = -1;
+#endif
+}
+
+
+static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+
+void Scheduler::idleWait(std::chrono::nanoseconds snap) {
+    if (!preciseTimers) {
+#if defined(__linux__)
+        // Submits what the last iteration queued, and wakes up early on completions.
+        if (threadIoUringInitialized()) {
+            getThreadIoUring().waitCompletion(snap);
+            return;
+        }
+#endif
+        std::this_thread::sleep_for(snap);
+        return;
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    delayedTasks.withLock([&deadline] (auto& it) {
+        if (!it.empty())
+            deadline = it.top().resolveTime;
+    });
+
+    auto now = std::chrono::steady_clock::now();
+    auto wakeAt = now + snap;
+    bool wakeForDeadline = deadline && *deadline < wakeAt;
+    if (wakeForDeadline)
+        wakeAt = *deadline;
+
+    auto sleepUntil = wakeAt - std::chrono::nanoseconds(preciseTimerSpin.load());
+
+    if (sleepUntil > now) {
+#if defined(__linux__)
+        // Default timer slack (50 us) would make every sleep that much late.
+        // Lowered for as long as the thread runs this scheduler (see `restoreTimerSlack`).
+        if (savedTimerSlack == -1) {
+            savedTimerSlack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+            prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+        }
+
+        if (threadIoUringInitialized())
+            getThreadIoUring().waitCompletion(sleepUntil - now);
+        else
+            std::this_thread::sleep_until(sleepUntil);
+#else
+        std::this_thread::sleep_until(sleepUntil);
+#endif
+    }
+
+    if (!wakeForDeadline)
+        return;
+
+    while (std::chrono::steady_clock::now() < wakeAt)
+        cpuRelax();
+}
+
+
 size_t Scheduler::dispatch() {
     size_t dispatched = 0;
     
@@ -157,6 +278,11 @@ size_t Scheduler::dispatch() {
     }
 
     dispatched += pollIoUringIfInitialized();
+
+    if (!tasksAfterCurrent.empty()) {
+        dispatched += tasksAfterCurrent.size();
+        __runTasksAfterCurrent();
+    }
     
     return dispatched;
 }
@@ -164,8 +290,10 @@ size_t Scheduler::dispatch() {
 
 bool Scheduler::hasPendingTasks() {
     return !regularTasks.empty() 
-        || !delayedTasks.empty() 
+        || liveDelayedTasks > 0
+        || !tasksAfterCurrent.empty()
         || !trackedPromises.empty() 
+        || ioOperations > 0
         || activeWorkers > 0;
 }
 
@@ -178,7 +306,13 @@ size_t Scheduler::dispatchDelayedTasks() {
     while (true) {
         std::optional<DelayedTask> task;
 
-        delayedTasks.withLock([&now, &task] (auto& it) {
+        delayedTasks.withLock([&now, &task, &count] (auto& it) {
+            // Cancelled entries are dropped once they reach the top, whenever that is.
+            while (!it.empty() && it.top().state->status != PromiseStatus::Pending) {
+                it.pop();
+                count++;
+            }
+
             if (!it.empty() && it.top().resolveTime <= now) {
                 task = it.top();
                 it.pop();
@@ -189,7 +323,15 @@ size_t Scheduler::dispatchDelayedTasks() {
             break;
         }
 
-        task->state->resolve();
+        if (task->interval) {
+            auto* interval = task->interval.get();
+            interval->self = std::move(task->interval);
+            this->addTask(interval->tick);
+        }
+        else if (task->state->resolve()) {
+            liveDelayedTasks--;
+        }
+
         count++;
     }
 
@@ -197,6 +339,41 @@ size_t Scheduler::dispatchDelayedTasks() {
 }
     
 
+void Scheduler::runInterval(IntervalTimer* timer) {
+    auto keepAlive = std::move(timer->self);
+
+    if (timer->state->status != PromiseStatus::Pending)
+        return;  // cancelled while the tick was queued.
+
+    try {
+        timer->fn();
+    }
+    catch (...) {
+        if (timer->state->reject(std::current_exception()))
+            liveDelayedTasks--;
+        return;
+    }
+
+    if (timer->state->status != PromiseStatus::Pending)
+        return;  // cancelled by [fn] itself.
+
+    auto now = std::chrono::steady_clock::now();
+    timer->deadline += timer->period;
+    if (timer->deadline <= now) {
+        // Fell behind by more than a period: skip to the next deadline still ahead.
+        timer->deadline += ((now - timer->deadline) / timer->period + 1) * timer->period;
+    }
+
+    delayedTasks.withLock([timer, &keepAlive] (auto& it) {
+        it.push({
+            .state = timer->state,
+            .resolveTime = timer->deadline,
+            .interval = std::move(keepAlive),
+        });
+    });
+}
+
+
 size_t Scheduler::dispatchRegularTasks() {
     size_t count = 0;
 
@@ -251,9 +428,36 @@ bool Scheduler::threadIoUringInitialized() {
 
 
 #if defined(__linux__)
+io::RingConfig Scheduler::threadRingConfig() {
+    io::RingConfig config = ringConfig;
+    if (!config.sqpoll || config.attachTo >= 0)
+        return config;
+
+    std::lock_guard _l {sqpollAnchorLock};
+
+    if (!sqpollAnchor) {
+        io::RingConfig anchorConfig = config;
+        anchorConfig.sqEntries = 1;  // never submitted to.
+        anchorConfig.cqEntries = 0;
+        anchorConfig.registerRingFd = false;  // it is destroyed on another thread.
+        sqpollAnchor = std::make_unique<io::IoUring>(anchorConfig);
+    }
+
+    // No SQPOLL for the anchor means none for anybody: don't try again on each thread.
+    if (!(sqpollAnchor->setupFlags() & IORING_SETUP_SQPOLL))
+        config.sqpoll = false;
+    else
+        config.attachTo = sqpollAnchor->ring().ring_fd;
+
+    return config;
+}
+
+
 io::IoUring& Scheduler::getThreadIoUring() {
     if (!threadIoUring) {
-        threadIoUring = std::make_unique<io::IoUring>();
+        threadIoUring = std::make_unique<io::IoUring>(
+            currentScheduler ? currentScheduler->threadRingConfig() : io::RingConfig {}
+        );
     }
 
     return *threadIoUring;
@@ -2,8 +2,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <exception>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <chrono>
 #include <queue>
 #include <vector>
@@ -11,9 +15,11 @@
 #include <unordered_set>
 #include <mutex>
 #include <semaphore>
+#include <stdexcept>
 #include <atomic>
 
 #include <vega/Promise.h>
+#include <vega/io/RingConfig.h>
 
 
 namespace vega {
@@ -26,9 +32,46 @@ class Scheduler {
 protected:
     using Task = std::function<void()>;
 
+    /**
+     * A `setInterval` timer. The same object goes back into `delayedTasks` after every tick,
+     * so ticking allocates nothing.
+     */
+    struct IntervalTimer {
+        std::function<void()> fn;
+        std::chrono::steady_clock::duration period;
+
+        /**
+         * Absolute time of the next tick. Advanced by `period` each time, so the ticks
+         * don't drift by however late each one runs.
+         */
+        std::chrono::steady_clock::time_point deadline;
+
+        /**
+         * State of the promise `setInterval` returned. Settles when the interval stops.
+         */
+        std::shared_ptr<PromiseState<void>> state;
+
+        /**
+         * Keeps the timer alive while its tick is queued (it is out of `delayedTasks` then).
+         */
+        std::shared_ptr<IntervalTimer> self;
+
+        /**
+         * Task queued on each tick. It only captures two pointers, so copying it into
+         * the task queue doesn't allocate either.
+         */
+        Task tick;
+    };
+
     struct DelayedTask {
         std::shared_ptr<PromiseState<void>> state;
         std::chrono::steady_clock::time_point resolveTime;
+
+        /**
+         * Set for `setInterval` entries, which queue the interval's tick instead of resolving `state`.
+         */
+        std::shared_ptr<IntervalTimer> interval;
+
         auto operator <=> (const DelayedTask& other) const { return resolveTime <=> other.resolveTime; }
         bool ready() const { return resolveTime <= std::chrono::steady_clock::now(); }
     };
@@ -58,8 +101,45 @@ protected:
         std::priority_queue<DelayedTask, std::vector<DelayedTask>, std::greater<DelayedTask>>
     > delayedTasks;
     
+    /**
+     * Delays and intervals whose promise hasn't settled yet. Cancelled entries stay in
+     * `delayedTasks` until they reach the top, so this (not the heap's size) tells whether
+     * timers keep the scheduler draining.
+     */
+    std::atomic<size_t> liveDelayedTasks {0};
+
     Synchronized<std::unordered_set<std::shared_ptr<PromiseStateBase>>> trackedPromises;
 
+    /**
+     * io_uring operations in flight that no tracked promise stands for. See `ioOperationStarted`.
+     */
+    std::atomic<size_t> ioOperations {0};
+
+    /**
+     * See `setPreciseTimers`.
+     */
+    std::atomic<bool> preciseTimers {false};
+    std::atomic<std::chrono::nanoseconds::rep> preciseTimerSpin {0};
+
+    /**
+     * See `setRingConfig`.
+     */
+    io::RingConfig ringConfig;
+
+#if defined(__linux__)
+    /**
+     * In SQPOLL mode: the ring owning the kernel polling thread, which the
+     * threads' rings attach to. Created with the first of them.
+     */
+    std::unique_ptr<io::IoUring> sqpollAnchor;
+    std::mutex sqpollAnchorLock;
+
+    /**
+     * Config for a new thread ring: `ringConfig`, attached to `sqpollAnchor` in SQPOLL mode.
+     */
+    io::RingConfig threadRingConfig();
+#endif
+
     
     /* -------- workers -------- */
     
@@ -85,10 +165,109 @@ protected:
 
     size_t removeCompletedTrackedPromises();
 
+    /**
+     * Run one tick of [timer] and put it back into `delayedTasks` for the next one.
+     */
+    void runInterval(IntervalTimer* timer);
+
     void startWorkers();
     void stopAndJoinWorkers();
     void workerThreadMain(size_t workerId);
 
+    /**
+     * One parallelFor-like call. Index range [begin, end) is cut into chunks, and
+     * up to one task per thread claims chunks from `nextChunk` until none are left.
+     * Fast threads simply claim more chunks, so uneven chunks balance themselves.
+     *
+     * [F] is called as fn(chunkIndex, chunkBegin, chunkEnd).
+     */
+    template <typename F>
+    struct ParallelJob {
+        size_t begin;
+        size_t end;
+        size_t chunkSize;
+        size_t nChunks;
+        F fn;
+
+        std::atomic<size_t> nextChunk {0};
+        std::atomic<size_t> runningTasks {0};
+        std::atomic<bool> failed {false};
+        std::exception_ptr error;
+
+        std::shared_ptr<PromiseState<void>> done = PromiseState<void>::create();
+
+        ParallelJob(size_t begin, size_t end, size_t chunkSize, F&& fn)
+            : begin(begin), end(end), chunkSize(chunkSize),
+              nChunks((end - begin + chunkSize - 1) / chunkSize), fn(std::move(fn)) {}
+
+        void run() {
+            while (!failed.load(std::memory_order_relaxed)) {
+                size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= nChunks)
+                    break;
+
+                size_t lo = begin + chunk * chunkSize;
+                size_t hi = std::min(lo + chunkSize, end);
+
+                try {
+                    fn(chunk, lo, hi);
+                }
+                catch (...) {
+                    if (!failed.exchange(true))
+                        error = std::current_exception();
+                }
+            }
+
+            if (runningTasks.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            if (error)
+                done->reject(error);
+            else
+                done->resolve();
+        }
+    };
+
+
+    /**
+     * Threads that run tasks of this scheduler (workers, or the main thread if there is none).
+     */
+    size_t concurrency() const { return nWorkers > 0 ? nWorkers : 1; }
+
+
+    /**
+     * Default chunk size: about 8 chunks per thread, which keeps per-chunk overhead
+     * (one atomic increment) negligible while leaving room to balance uneven items.
+     */
+    size_t defaultGrain(size_t n) const {
+        return std::max<size_t>(1, n / (concurrency() * 8));
+    }
+
+
+    /**
+     * Run [fn] (chunkIndex, chunkBegin, chunkEnd) over [begin, end) cut into chunks of [grain].
+     */
+    template <typename F>
+    Promise<void> parallelChunks(size_t begin, size_t end, size_t grain, F fn) {
+        if (begin >= end)
+            return Promise<void>::resolve();
+
+        if (grain == 0)
+            grain = defaultGrain(end - begin);
+
+        auto job = std::make_shared<ParallelJob<F>>(begin, end, grain, std::move(fn));
+        job->done->scheduler = this;
+
+        size_t nTasks = std::min(concurrency(), job->nChunks);
+        job->runningTasks = nTasks;
+
+        for (size_t i = 0; i < nTasks; i++)
+            this->addTask([job] () { job->run(); });
+
+        return Promise<void>(job->done);
+    }
+
+
     /**
      * Dispatch tasks on scheduler's main thread.
      * 
@@ -106,7 +285,7 @@ protected:
             size_t removedPromises = removeCompletedTrackedPromises();
 
             if (dispatched + removedPromises == 0) {
-                std::this_thread::sleep_for(snap);
+                idleWait(std::chrono::duration_cast<std::chrono::nanoseconds>(snap));
             }
         }
     }
@@ -119,6 +298,17 @@ protected:
 
     void drain() { drain(std::chrono::microseconds(100)); }
 
+    /**
+     * Called by `drain` when nothing was dispatched: wait up to [snap] for something to do.
+     * In precise timer mode, wakes up right at the next delayed task's deadline.
+     */
+    void idleWait(std::chrono::nanoseconds snap);
+
+    /**
+     * Put back the calling thread's timer slack, if `idleWait` lowered it.
+     */
+    static void restoreTimerSlack();
+
     /**
      * Set thread's current scheduler as [scheduler].
      *
@@ -153,6 +343,35 @@ public:
      */
     static Scheduler& getCurrent();
 
+    /**
+     * Opt into precise timers, for sub-millisecond `delay`s (pacing, retries...).
+     *
+     * Normally the main loop sleeps a fixed 100 us whenever it is idle, so delays complete
+     * up to a few hundred microseconds late. In precise mode it sleeps until the next
+     * delayed task's deadline minus [spin] instead (on the thread's io_uring if it has one,
+     * so I/O completions still wake it, with the thread's timer slack set to the minimum),
+     * then spins for the rest. Lateness drops to microseconds, at the cost of one core
+     * spinning for up to [spin] before each deadline.
+     */
+    void setPreciseTimers(bool enabled, std::chrono::nanoseconds spin = std::chrono::microseconds(50)) {
+        preciseTimerSpin = spin.count();
+        preciseTimers = enabled;
+    }
+
+
+    /**
+     * Set up the io_uring of each thread running this scheduler with [config]:
+     * queue sizes and setup flags (see io::RingConfig).
+     *
+     * A thread's ring is created the first time it does I/O, with the config of the
+     * scheduler it runs at that time, and kept for the thread's lifetime. So call this
+     * before the scheduler runs anything.
+     */
+    void setRingConfig(const io::RingConfig& config) { ringConfig = config; }
+
+    const io::RingConfig& getRingConfig() const { return ringConfig; }
+
+
     /**
      * Check if the current thread is a worker thread of this scheduler.
      */
@@ -165,6 +384,9 @@ public:
 
 
     void track(std::shared_ptr<PromiseStateBase> promise) {
+        if (!promise)
+            return;  // promise created already fulfilled. Nothing to track.
+
         trackedPromises.withLock([&promise] (auto& it) {
             it.emplace(std::move(promise));
         });
@@ -177,6 +399,14 @@ public:
     }
 
 
+    /**
+     * Count an io_uring operation awaited without a promise (`io::IoUring::Operation`),
+     * so `drain` doesn't stop while it is in flight.
+     */
+    void ioOperationStarted() { ioOperations++; }
+    void ioOperationFinished() { ioOperations--; }
+
+
     template<typename F>
     requires std::invocable<F> && std::same_as<std::invoke_result_t<F>, Promise<void>>
     void runBlocking(F&& callable) {
@@ -184,11 +414,10 @@ public:
 
         auto promise = callable();
 
-        trackedPromises.withLock([&promise] (auto& it) {
-            it.emplace(promise.state);
-        });
+        this->track(promise);
 
         drain();
+        restoreTimerSlack();
 
         Scheduler::setCurrent(previousScheduler);
     }
@@ -202,6 +431,7 @@ public:
         this->addTask([&callable] () { callable(); });
 
         drain();
+        restoreTimerSlack();
 
         Scheduler::setCurrent(previousScheduler);
     }
@@ -215,21 +445,159 @@ public:
 
         std::chrono::steady_clock::time_point resolveTime = std::chrono::steady_clock::now() + duration;
         
+        liveDelayedTasks++;
         delayedTasks.withLock([&ret, resolveTime] (auto& it) {
             it.push({
                 .state = ret.state,
                 .resolveTime = resolveTime,
+                .interval = nullptr,
             });
         });
 
+        ret.state->onCancel([this, state = ret.state.get()] () {
+            if (state->reject(std::make_exception_ptr(CancelledError())))
+                liveDelayedTasks--;
+        });
+
         return ret;
     }
 
 
     template<typename Func, typename _Rep, typename _Period>
     Promise<void> setTimeout(Func func, const std::chrono::duration<_Rep, _Period>& duration) {
-        co_await this->delay(duration);
-        func();
+        return this->delay(duration).map([func = std::move(func)] () mutable { func(); });
+    }
+
+
+    /**
+     * Call [func] () every [period], until the returned promise is cancelled
+     * (it then rejects with CancelledError) or [func] throws (it then rejects with that).
+     *
+     *     auto heartbeat = scheduler.setInterval([&] { conn.ping(); }, 1s);
+     *     ...
+     *     heartbeat.state->cancel();
+     *
+     * Ticks are due at fixed absolute times (start + k * period), so they don't drift.
+     * If a tick runs later than the next one was due, missed ticks are skipped instead
+     * of run back to back. One timer entry is reused for all ticks, which don't allocate.
+     */
+    template<typename Func, typename _Rep, typename _Period>
+    Promise<void> setInterval(Func func, const std::chrono::duration<_Rep, _Period>& period) {
+        auto stepping = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        if (stepping.count() <= 0)
+            return Promise<void>::reject(std::invalid_argument("setInterval: period must be positive"));
+
+        auto timer = std::make_shared<IntervalTimer>();
+        timer->fn = std::move(func);
+        timer->period = stepping;
+        timer->deadline = std::chrono::steady_clock::now() + stepping;
+        timer->tick = [this, timer = timer.get()] () { this->runInterval(timer); };
+
+        Promise<void> ret;
+        ret.state->scheduler = this;
+        timer->state = ret.state;
+
+        ret.state->onCancel([this, state = ret.state.get()] () {
+            if (state->reject(std::make_exception_ptr(CancelledError())))
+                liveDelayedTasks--;
+        });
+
+        liveDelayedTasks++;
+        delayedTasks.withLock([&timer] (auto& it) {
+            it.push({
+                .state = timer->state,
+                .resolveTime = timer->deadline,
+                .interval = std::move(timer),
+            });
+        });
+
+        return ret;
+    }
+
+
+    /**
+     * Call [fn] (i) for every i in [begin, end) on the worker threads.
+     *
+     * Indices are processed in chunks of [grain] (0 picks one automatically),
+     * so per-index overhead is a plain function call. If some call throws,
+     * remaining chunks are skipped and the returned promise rejects.
+     */
+    template <typename F>
+    Promise<void> parallelFor(size_t begin, size_t end, F fn, size_t grain = 0) {
+        return parallelChunks(begin, end, grain, [fn = std::move(fn)] (size_t, size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; i++)
+                fn(i);
+        });
+    }
+
+
+    /**
+     * Compute reduce(... reduce(reduce(init, map(begin)), map(begin + 1)) ..., map(end - 1))
+     * on the worker threads.
+     *
+     * Chunks are reduced in parallel and the partial results are combined in index order,
+     * so [reduce] must be associative but doesn't need to be commutative.
+     */
+    template <typename T, typename Map, typename Reduce>
+    Promise<T> parallelReduce(size_t begin, size_t end, T init, Map map, Reduce reduce, size_t grain = 0) {
+        if (begin >= end)
+            co_return init;
+
+        if (grain == 0)
+            grain = defaultGrain(end - begin);
+
+        std::vector<std::optional<T>> partials((end - begin + grain - 1) / grain);
+
+        co_await parallelChunks(begin, end, grain, [&partials, &map, &reduce] (size_t chunk, size_t lo, size_t hi) {
+            T acc = map(lo);
+            for (size_t i = lo + 1; i < hi; i++)
+                acc = reduce(std::move(acc), map(i));
+            partials[chunk].emplace(std::move(acc));
+        });
+
+        for (auto& partial : partials)
+            init = reduce(std::move(init), std::move(*partial));
+
+        co_return init;
+    }
+
+
+    /**
+     * Parallel std::transform: out[i] = fn(first[i]) for random access iterators.
+     */
+    template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename F>
+    Promise<void> parallelTransform(InIt first, InIt last, OutIt out, F fn, size_t grain = 0) {
+        return parallelChunks(0, last - first, grain, [first, out, fn = std::move(fn)] (size_t, size_t lo, size_t hi) {
+            std::transform(first + lo, first + hi, out + lo, fn);
+        });
+    }
+
+
+    /**
+     * Parallel sort: chunks are sorted with std::sort in parallel, then merged pairwise
+     * (each round of merges in parallel too). Not stable.
+     */
+    template <std::random_access_iterator It, typename Compare = std::less<>>
+    Promise<void> parallelSort(It first, It last, Compare comp = {}) {
+        size_t n = last - first;
+
+        // Sorting is cheap per element, so chunks are at least a few thousand elements.
+        size_t grain = std::max<size_t>(defaultGrain(n), 4096);
+
+        co_await parallelChunks(0, n, grain, [first, &comp] (size_t, size_t lo, size_t hi) {
+            std::sort(first + lo, first + hi, comp);
+        });
+
+        for (size_t width = grain; width < n; width *= 2) {
+            size_t nPairs = (n + 2 * width - 1) / (2 * width);
+
+            co_await parallelFor(0, nPairs, [first, n, width, &comp] (size_t pair) {
+                size_t lo = pair * 2 * width;
+                size_t mid = std::min(lo + width, n);
+                size_t hi = std::min(lo + 2 * width, n);
+                std::inplace_merge(first + lo, first + mid, first + hi, comp);
+            }, 1);
+        }
     }
 
 
@@ -242,6 +610,15 @@ public:
             taskSemaphore.release();
     }
 
+
+    /**
+     * Run [task] on this thread once what runs now is done: the current task on a worker,
+     * or the current loop iteration on the thread running `runBlocking`. Unlike `addTask`,
+     * another worker can't pick it up in the meantime. Off this scheduler's threads,
+     * same as `addTask`.
+     */
+    void addTaskAfterCurrent(Task task);
+
     bool shouldQueueTask() const;
 
     friend Scheduler* setCurrentScheduler(Scheduler* scheduler);
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <vega/Promise.h>
+#include <vega/Scheduler.h>
+
+
+namespace vega {
+
+
+/**
+ * Serial executor on top of a Scheduler, like a serial dispatch queue or an actor's mailbox.
+ *
+ * Work posted to a strand runs on whatever worker of the scheduler is free, but never
+ * concurrently with other work of the same strand, and in posting order. So state that is
+ * only touched from one strand needs no mutex, and isn't pinned to a thread either.
+ *
+ * While the strand is busy, posted work is run in batches by a single scheduler task
+ * instead of one task per item.
+ *
+ * A coroutine enters the strand with `co_await strand`: it continues inside the strand
+ * until its next suspension point. The strand must outlive all work posted to it, so code
+ * running inside the strand must not destroy it.
+ */
+class Strand {
+protected:
+    struct Node {
+        std::atomic<Node*> next {nullptr};
+        std::function<void()> fn;
+    };
+
+    Scheduler& scheduler_;
+
+    /**
+     * Vyukov's intrusive MPSC queue: producers push at `head_`, the running drain pops at `tail_`.
+     */
+    std::atomic<Node*> head_;
+    Node* tail_;
+    Node stub_;
+
+    /**
+     * Posted but not yet run. The poster that raises it from zero schedules a drain.
+     */
+    std::atomic<size_t> pending_ {0};
+
+    /**
+     * Items run per scheduler task before yielding to other tasks.
+     */
+    static constexpr size_t BATCH_SIZE = 64;
+
+    /**
+     * Drains still touching this strand. The destructor waits for them, so work that
+     * resumes someone else who then destroys the strand doesn't race with the drain's epilogue.
+     */
+    std::atomic<int> activeDrains_ {0};
+
+    static inline thread_local Strand* current_ = nullptr;
+
+
+    void push(Node* node) {
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+
+    /**
+     * Pop the oldest node. Only called while `pending_` says one was pushed, so it may
+     * briefly wait for a producer that is between its two steps in `push`.
+     */
+    Node* pop() {
+        while (true) {
+            Node* tail = tail_;
+            Node* next = tail->next.load(std::memory_order_acquire);
+
+            if (tail == &stub_) {
+                if (!next)
+                    continue;  // producer hasn't linked its node yet.
+
+                tail_ = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+
+            if (tail != head_.load(std::memory_order_acquire))
+                continue;  // producer hasn't linked its node yet.
+
+            // `tail` is the last node. Put the stub behind it so it can be popped.
+            stub_.next.store(nullptr, std::memory_order_relaxed);
+            push(&stub_);
+        }
+    }
+
+
+    void drain() {
+        activeDrains_.fetch_add(1, std::memory_order_relaxed);
+        Strand* previous = std::exchange(current_, this);
+
+        bool emptied = false;
+        for (size_t done = 0; done < BATCH_SIZE; done++) {
+            Node* node = pop();
+            node->fn();
+            delete node;
+
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                emptied = true;
+                break;  // queue empty, and the next post schedules a new drain.
+            }
+        }
+
+        current_ = previous;
+
+        // Stopped at the batch limit with work left: nobody else will schedule the rest.
+        // (Once emptied, a post may have scheduled a drain already, so don't add another.)
+        if (!emptied)
+            scheduler_.addTask([this] () { drain(); });
+
+        activeDrains_.fetch_sub(1, std::memory_order_release);  // last access to `this`.
+    }
+
+
+public:
+    explicit Strand(Scheduler& scheduler) : scheduler_(scheduler), head_(&stub_), tail_(&stub_) {}
+
+    ~Strand() {
+        while (activeDrains_.load(std::memory_order_acquire) > 0)
+            std::this_thread::yield();
+    }
+
+    Strand(const Strand&) = delete;
+    Strand& operator = (const Strand&) = delete;
+
+
+    Scheduler& scheduler() { return scheduler_; }
+
+    /**
+     * True if the calling code is running inside this strand.
+     */
+    bool runningInThisThread() const { return current_ == this; }
+
+
+    /**
+     * Run [fn] () on the strand, after everything posted before it.
+     */
+    void post(std::function<void()> fn) {
+        auto* node = new Node;
+        node->fn = std::move(fn);
+        push(node);
+
+        if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+            scheduler_.addTask([this] () { drain(); });
+    }
+
+
+    /**
+     * Run [fn] () on the strand and get its result. The awaiting coroutine is resumed
+     * through its scheduler, outside the strand, so it may go on to destroy the strand.
+     */
+    template <typename F>
+    auto run(F fn) -> Promise<std::invoke_result_t<F>> {
+        using R = std::invoke_result_t<F>;
+
+        Promise<R> result;
+        result.state->scheduler = &getCurrentScheduler();
+
+        post([fn = std::move(fn), state = result.state] () mutable {
+            // Settle a detached state inside the strand, and hand its outcome over afterwards.
+            auto outcome = PromiseState<R>::create();
+            __promise_details::resolveWith(outcome.get(), fn);
+
+            state->scheduler->addTask([state = std::move(state), outcome = std::move(outcome)] () {
+                if (outcome->status == PromiseStatus::Rejected)
+                    state->reject(outcome->exception);
+                else if constexpr (std::is_void_v<R>)
+                    state->resolve();
+                else
+                    state->resolve(std::move(*outcome->value));
+            });
+        });
+
+        return result;
+    }
+
+
+    struct Awaiter {
+        Strand& strand;
+
+        bool await_ready() { return strand.runningInThisThread(); }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            strand.post([h] () { h.resume(); });
+        }
+
+        void await_resume() {}
+    };
+
+    /**
+     * Enter the strand. The coroutine continues inside it until its next suspension.
+     */
+    Awaiter operator co_await() { return Awaiter { *this }; }
+};
+
+
+}  // namespace vega
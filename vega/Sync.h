@@ -0,0 +1,440 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+// Coroutine-aware synchronization primitives.
+// Waiting suspends the coroutine instead of blocking the worker thread.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+#include <vega/Scheduler.h>
+
+
+/**
+ * namespace vega::__sync_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace vega::__sync_details {
+
+
+using Waiters = std::deque<std::shared_ptr<PromiseState<void>>>;
+
+
+/**
+ * Resume a parked waiter through its scheduler's task queue rather than inline, so a chain
+ * of handoffs (A releases to B, B to C, ...) doesn't nest on the releaser's stack.
+ *
+ * If the waiter was cancelled after it was taken off the queue, whoever awaited it won't act
+ * on the wakeup (see `PromiseStateBase::cancel`), and [ifCancelled] () passes it on instead.
+ */
+inline void wake(std::shared_ptr<PromiseState<void>> waiter, std::function<void()> ifCancelled = nullptr) {
+    auto* scheduler = waiter->scheduler;
+
+    auto resume = [waiter = std::move(waiter), ifCancelled = std::move(ifCancelled)] () {
+        waiter->resolve();
+
+        if (waiter->cancelled && ifCancelled)
+            ifCancelled();
+    };
+
+    if (scheduler)
+        scheduler->addTask(std::move(resume));
+    else
+        resume();
+}
+
+
+/**
+ * Queue a waiter on [waiters]. Must hold [waitersLock].
+ *
+ * Cancelling it takes it off the queue (calling [onDropped] () with the lock still held)
+ * and rejects it with CancelledError. The queue's owner must outlive it.
+ */
+inline Promise<void> park(std::mutex& waitersLock, Waiters& waiters, std::function<void()> onDropped = nullptr) {
+    Promise<void> p;
+    p.state->scheduler = &getCurrentScheduler();
+    waiters.push_back(p.state);
+
+    auto hook = [&waitersLock, &waiters, state = p.state.get(), onDropped = std::move(onDropped)] () {
+        {
+            std::lock_guard _l {waitersLock};
+
+            auto it = std::ranges::find_if(waiters, [state] (auto& waiter) { return waiter.get() == state; });
+            if (it == waiters.end())
+                return;  // Already being woken.
+
+            waiters.erase(it);
+            if (onDropped)
+                onDropped();
+        }
+
+        state->reject(std::make_exception_ptr(CancelledError()));
+    };
+
+    p.state->onCancel(std::move(hook));
+    return p;
+}
+
+
+}  // namespace vega::__sync_details
+
+
+namespace vega {
+
+
+/**
+ * Counting semaphore for coroutines.
+ *
+ * `value_` is the number of free permits minus the number of waiters. Acquiring and
+ * releasing without contention is a single atomic operation. When there are waiters,
+ * `release` hands its permit directly to the longest waiting one (FIFO), which is resumed
+ * on its own scheduler.
+ *
+ * A waiting `acquire` can be cancelled: it rejects with CancelledError and takes no permit.
+ */
+class AsyncSemaphore {
+protected:
+    std::atomic<std::ptrdiff_t> value_;
+
+    std::mutex waitersLock_;
+    __sync_details::Waiters waiters_;
+
+    /**
+     * Permits handed over by `release` before their waiter managed to park.
+     */
+    size_t handoffs_ = 0;
+
+    /**
+     * Permits on their way (released, not yet handed over) to waiters that were cancelled since.
+     * The `release` carrying one frees it again instead.
+     */
+    size_t abandoned_ = 0;
+
+
+    /**
+     * A cancelled waiter left the queue: give up its place in `value_`. If every waiter
+     * already has a permit on its way, one of those is left over instead. Must hold waitersLock_.
+     */
+    void dropWaiter() {
+        auto value = value_.load(std::memory_order_relaxed);
+
+        while (value < 0) {
+            if (value_.compare_exchange_weak(value, value + 1, std::memory_order_relaxed))
+                return;
+        }
+
+        abandoned_++;
+    }
+
+public:
+    explicit AsyncSemaphore(std::ptrdiff_t permits) : value_(permits) {}
+
+    AsyncSemaphore(const AsyncSemaphore&) = delete;
+    AsyncSemaphore& operator = (const AsyncSemaphore&) = delete;
+
+
+    /**
+     * Take a permit if one is free, without waiting.
+     */
+    bool tryAcquire() {
+        auto value = value_.load(std::memory_order_relaxed);
+        while (value > 0) {
+            if (value_.compare_exchange_weak(value, value - 1, std::memory_order_acquire))
+                return true;
+        }
+        return false;
+    }
+
+
+    /**
+     * Take a permit, suspending until one is released if none is free.
+     */
+    Promise<void> acquire() {
+        if (value_.fetch_sub(1, std::memory_order_acquire) > 0)
+            return Promise<void>::resolve();
+
+        std::lock_guard _l {waitersLock_};
+
+        if (handoffs_ > 0) {
+            handoffs_--;
+            return Promise<void>::resolve();
+        }
+
+        return __sync_details::park(waitersLock_, waiters_, [this] () { dropWaiter(); });
+    }
+
+
+    void release(std::ptrdiff_t n = 1) {
+        for (; n > 0; n--) {
+            if (value_.fetch_add(1, std::memory_order_release) >= 0)
+                continue;
+
+            // Someone is waiting, or about to: hand the permit over.
+            std::shared_ptr<PromiseState<void>> waiter;
+            {
+                std::lock_guard _l {waitersLock_};
+
+                if (waiters_.empty()) {
+                    if (abandoned_ > 0) {
+                        // Its waiter is gone: release the permit once more.
+                        abandoned_--;
+                        n++;
+                    }
+                    else {
+                        handoffs_++;
+                    }
+
+                    continue;
+                }
+
+                waiter = std::move(waiters_.front());
+                waiters_.pop_front();
+            }
+
+            __sync_details::wake(std::move(waiter), [this] () { release(); });
+        }
+    }
+
+
+    /**
+     * Free permits (negative while coroutines are waiting). For diagnostics only.
+     */
+    std::ptrdiff_t available() const { return value_.load(std::memory_order_relaxed); }
+};
+
+
+/**
+ * Mutex for coroutines. `co_await lock()` suspends instead of blocking the thread,
+ * and `unlock` hands the mutex over to waiters in FIFO order.
+ *
+ * Unlike std::mutex, it may be unlocked from a different thread than it was locked on
+ * (the coroutine holding it may migrate between workers).
+ */
+class AsyncMutex {
+protected:
+    AsyncSemaphore semaphore_ {1};
+
+public:
+
+    /**
+     * Unlocks the mutex when destroyed.
+     */
+    class Guard {
+    protected:
+        AsyncMutex* mutex_ = nullptr;
+
+    public:
+        Guard() = default;
+        explicit Guard(AsyncMutex* mutex) : mutex_(mutex) {}
+
+        Guard(const Guard&) = delete;
+        Guard& operator = (const Guard&) = delete;
+
+        Guard(Guard&& other) noexcept : mutex_(std::exchange(other.mutex_, nullptr)) {}
+
+        Guard& operator = (Guard&& other) noexcept {
+            if (this != &other) {
+                unlock();
+                mutex_ = std::exchange(other.mutex_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Guard() { unlock(); }
+
+        void unlock() {
+            if (mutex_)
+                std::exchange(mutex_, nullptr)->unlock();
+        }
+
+        bool ownsLock() const { return mutex_ != nullptr; }
+    };
+
+
+    bool tryLock() { return semaphore_.tryAcquire(); }
+
+    Promise<void> lock() { return semaphore_.acquire(); }
+
+    void unlock() { semaphore_.release(); }
+
+    /**
+     * Lock, and get a Guard that unlocks when it goes out of scope:
+     *
+     *     auto guard = co_await mutex.scopedLock();
+     */
+    Promise<Guard> scopedLock() {
+        return lock().map([this] () { return Guard(this); });
+    }
+};
+
+
+/**
+ * Condition variable for coroutines, used with AsyncMutex.
+ */
+class AsyncConditionVariable {
+protected:
+    std::mutex waitersLock_;
+    __sync_details::Waiters waiters_;
+
+
+    /**
+     * `mutex.lock()`, shielded from cancellation: the promise awaited is not the lock's,
+     * so cancelling the awaiting coroutine doesn't reach it. The coroutine then throws
+     * CancelledError from the co_await with the mutex held.
+     */
+    static Promise<void> relock(AsyncMutex& mutex) {
+        auto locked = mutex.lock().getState();
+
+        Promise<void> ret;
+        ret.state->scheduler = &getCurrentScheduler();
+        locked->addContinuation([state = ret.state] () { state->resolve(); });
+
+        return ret;
+    }
+
+public:
+    AsyncConditionVariable() = default;
+
+    AsyncConditionVariable(const AsyncConditionVariable&) = delete;
+    AsyncConditionVariable& operator = (const AsyncConditionVariable&) = delete;
+
+
+    /**
+     * Unlock [mutex], wait for a notification, then lock [mutex] again.
+     * [mutex] must be locked by the caller, and is locked again when this settles,
+     * even if it rejects with CancelledError.
+     */
+    Promise<void> wait(AsyncMutex& mutex) {
+        Promise<void> notified;
+        {
+            std::lock_guard _l {waitersLock_};
+            notified = __sync_details::park(waitersLock_, waiters_);
+        }
+
+        // Parked before unlocking, so a notification right after unlock isn't lost.
+        mutex.unlock();
+
+        std::exception_ptr error;
+        try {
+            co_await notified;
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        co_await relock(mutex);
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+
+    /**
+     * Wait until [pred] () holds. [mutex] must be locked by the caller, and is locked when this resolves.
+     */
+    template <typename Pred>
+    Promise<void> wait(AsyncMutex& mutex, Pred pred) {
+        while (!pred())
+            co_await wait(mutex);
+    }
+
+
+    void notifyOne() {
+        std::shared_ptr<PromiseState<void>> waiter;
+        {
+            std::lock_guard _l {waitersLock_};
+            if (waiters_.empty())
+                return;
+
+            waiter = std::move(waiters_.front());
+            waiters_.pop_front();
+        }
+
+        __sync_details::wake(std::move(waiter), [this] () { notifyOne(); });
+    }
+
+
+    void notifyAll() {
+        __sync_details::Waiters waiters;
+        {
+            std::lock_guard _l {waitersLock_};
+            waiters.swap(waiters_);
+        }
+
+        for (auto& waiter : waiters)
+            __sync_details::wake(std::move(waiter));
+    }
+};
+
+
+/**
+ * Wait for a group of tasks to finish, like Go's sync.WaitGroup.
+ *
+ *     WaitGroup wg;
+ *     wg.add(n);
+ *     ... each task calls wg.done() when finished ...
+ *     co_await wg.wait();
+ */
+class WaitGroup {
+protected:
+    std::atomic<std::ptrdiff_t> count_ {0};
+
+    std::mutex waitersLock_;
+    __sync_details::Waiters waiters_;
+
+public:
+    WaitGroup() = default;
+
+    WaitGroup(const WaitGroup&) = delete;
+    WaitGroup& operator = (const WaitGroup&) = delete;
+
+
+    void add(std::ptrdiff_t n = 1) {
+        if (count_.fetch_add(n, std::memory_order_acq_rel) + n > 0)
+            return;
+
+        __sync_details::Waiters waiters;
+        {
+            std::lock_guard _l {waitersLock_};
+            waiters.swap(waiters_);
+        }
+
+        for (auto& waiter : waiters)
+            __sync_details::wake(std::move(waiter));
+    }
+
+
+    void done() { add(-1); }
+
+
+    /**
+     * Resolves once the count drops to zero (right away if it is zero).
+     */
+    Promise<void> wait() {
+        if (count_.load(std::memory_order_acquire) <= 0)
+            return Promise<void>::resolve();
+
+        std::lock_guard _l {waitersLock_};
+
+        // `add` takes the lock after dropping the count to zero, so checking again here is enough.
+        if (count_.load(std::memory_order_acquire) <= 0)
+            return Promise<void>::resolve();
+
+        return __sync_details::park(waitersLock_, waiters_);
+    }
+
+
+    std::ptrdiff_t count() const { return count_.load(std::memory_order_relaxed); }
+};
+
+
+}  // namespace vega
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include <vega/Promise.h>
+
+
+/**
+ * namespace vega::__task_scope_details is NOT meant to be used directly. It should only be used inside this file.
+ */
+namespace vega::__task_scope_details {
+
+
+/**
+ * Shared by a TaskScope and its children's continuations, so a child finishing after
+ * the scope object is gone is harmless.
+ */
+struct ScopeState : std::enable_shared_from_this<ScopeState> {
+    using Children = std::list<std::shared_ptr<PromiseStateBase>>;
+
+    std::atomic<bool> cancelled {false};
+
+    /**
+     * Guards `children`, `error` and `joined`.
+     */
+    std::mutex lock;
+
+    /**
+     * Running children, so `cancel` can reach them; its size is the scope's child count.
+     * Each child erases its own entry when it finishes, through the iterator it got on insertion.
+     */
+    Children children;
+
+    /**
+     * First failure of a child (CancelledError doesn't count).
+     */
+    std::exception_ptr error;
+
+    /**
+     * Promise handed out by `join` while children are still running.
+     */
+    std::shared_ptr<PromiseState<void>> joined;
+
+
+    void cancel() {
+        if (cancelled.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        Children toCancel;
+        {
+            std::lock_guard _l {lock};
+            toCancel = children;
+        }
+
+        for (auto& child : toCancel)
+            child->cancel();
+    }
+
+
+    /**
+     * [keepAlive] is released once [child] finishes (used for the callable a child runs in).
+     */
+    void attach(const std::shared_ptr<PromiseStateBase>& child, std::shared_ptr<void> keepAlive = nullptr) {
+        Children::iterator it;
+        {
+            std::lock_guard _l {lock};
+            it = children.insert(children.end(), child);
+        }
+
+        if (cancelled.load(std::memory_order_acquire))
+            child->cancel();
+
+        child->addContinuation([scope = shared_from_this(), it, child = child.get(), keepAlive = std::move(keepAlive)] () {
+            scope->finish(it, child);
+        });
+    }
+
+
+    void finish(Children::iterator it, PromiseStateBase* child) {
+        bool failed = false;
+        if (child->status == PromiseStatus::Rejected) {
+            try {
+                std::rethrow_exception(child->exception);
+            }
+            catch (const CancelledError&) {}
+            catch (...) {
+                failed = true;
+            }
+        }
+
+        std::shared_ptr<PromiseState<void>> toSettle;
+        std::exception_ptr error;
+        bool cancelSiblings = false;
+        {
+            std::lock_guard _l {lock};
+            children.erase(it);
+
+            if (failed && !this->error) {
+                this->error = child->exception;
+                cancelSiblings = true;
+            }
+
+            if (children.empty()) {
+                toSettle = std::move(joined);
+                error = this->error;
+            }
+        }
+
+        // One failing child takes its siblings down, as the scope's result is an error anyway.
+        if (cancelSiblings)
+            cancel();
+
+        if (!toSettle)
+            return;
+
+        if (error)
+            toSettle->reject(error);
+        else
+            toSettle->resolve();
+    }
+};
+
+
+}  // namespace vega::__task_scope_details
+
+
+namespace vega {
+
+
+/**
+ * Structured concurrency: a scope (nursery) owning the coroutines spawned into it.
+ *
+ *     TaskScope scope;
+ *     for (auto& url : urls)
+ *         scope.spawn(fetch(url));
+ *     co_await scope.join();
+ *
+ * Children are kept in a list of their own, so they can be counted and cancelled;
+ * spawning and finishing are O(1), and nothing goes through the scheduler's tracked
+ * promise set.
+ *
+ * `cancel()` cancels every running child (and those spawned afterwards): each is cancelled
+ * through its promise, which stops whatever it is suspended on (delays, io_uring operations)
+ * and makes it throw CancelledError from there. CPU-bound children can check `cancelled()`
+ * or call `throwIfCancelled()` in their loops.
+ *
+ * If a child fails, its siblings are cancelled and `join()` rejects with that error once all
+ * have finished. Children failing with CancelledError don't count as failures.
+ *
+ * Destroying the scope cancels the children still running.
+ */
+class TaskScope {
+protected:
+    std::shared_ptr<__task_scope_details::ScopeState> state_ =
+        std::make_shared<__task_scope_details::ScopeState>();
+
+public:
+    TaskScope() = default;
+
+    TaskScope(const TaskScope&) = delete;
+    TaskScope& operator = (const TaskScope&) = delete;
+
+    ~TaskScope() {
+        if (size() > 0)
+            cancel();
+    }
+
+
+    /**
+     * Add a running promise to the scope.
+     */
+    template <typename T>
+    void spawn(Promise<T> child) {
+        if (!child.state || child.state->status == PromiseStatus::Fulfilled)
+            return;  // already done: nothing to wait for or cancel.
+
+        state_->attach(child.state);
+    }
+
+
+    /**
+     * Start [fn] () as a child, unless the scope is already cancelled.
+     * [fn] returns a Promise, typically as a coroutine lambda. The scope keeps [fn] alive
+     * until the child finishes, so the lambda's captures stay valid across its co_awaits.
+     */
+    template <typename F>
+    requires std::invocable<std::decay_t<F>&> && __promise_details::is_promise<std::invoke_result_t<std::decay_t<F>&>>::value
+    void spawn(F&& fn) {
+        using R = std::invoke_result_t<std::decay_t<F>&>;
+
+        if (cancelled())
+            return;
+
+        auto holder = std::make_shared<std::decay_t<F>>(std::forward<F>(fn));
+
+        R child = [&holder] () {
+            try {
+                return std::invoke(*holder);
+            }
+            catch (...) {
+                return R::reject(std::current_exception());
+            }
+        }();
+
+        if (!child.state || child.state->status == PromiseStatus::Fulfilled)
+            return;
+
+        state_->attach(child.state, std::move(holder));
+    }
+
+
+    /**
+     * Resolves once every child has finished. Rejects with the first child's failure, if any.
+     */
+    Promise<void> join() {
+        std::lock_guard _l {state_->lock};
+
+        if (state_->children.empty()) {
+            if (state_->error)
+                return Promise<void>::reject(state_->error);
+            return Promise<void>::resolve();
+        }
+
+        if (!state_->joined) {
+            state_->joined = PromiseState<void>::create();
+            state_->joined->scheduler = &getCurrentScheduler();
+        }
+
+        return Promise<void>(state_->joined);
+    }
+
+
+    void cancel() { state_->cancel(); }
+
+    bool cancelled() const { return state_->cancelled.load(std::memory_order_acquire); }
+
+    /**
+     * Cancellation check for CPU-bound children, which have no co_await that would throw.
+     */
+    void throwIfCancelled() const {
+        if (cancelled())
+            throw CancelledError();
+    }
+
+
+    /**
+     * Children still running.
+     */
+    size_t size() const {
+        std::lock_guard _l {state_->lock};
+        return state_->children.size();
+    }
+};
+
+
+}  // namespace vega
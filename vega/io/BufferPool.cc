@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#if defined(__linux__)
+
+#include <vega/io/BufferPool.h>
+
+#include <new>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+#include <vega/io/IoUring.h>
+#include <vega/Scheduler.h>
+
+
+namespace vega::io {
+
+
+static const size_t __HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+static const size_t __PAGE_SIZE = 4096;
+
+
+static size_t __roundUp(size_t size, size_t to) {
+    return (size + to - 1) / to * to;
+}
+
+
+void BufferLease::release() {
+    if (!data_)
+        return;
+
+    pool_->giveBack(data_);
+    pool_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+BufferPool::BufferPool(size_t bufferSize, size_t count, bool hugePages)
+    : ring_(IoUring::getThreadIoUring()), bufferSize_(bufferSize), count_(count)
+{
+    if (bufferSize == 0 || count == 0)
+        throw std::invalid_argument("BufferPool: buffer size and count must be positive");
+
+    size_t size = bufferSize * count;
+    void* slab = MAP_FAILED;
+
+    if (hugePages) {
+        slabSize_ = __roundUp(size, __HUGE_PAGE_SIZE);
+        slab = mmap(nullptr, slabSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugePages_ = slab != MAP_FAILED;
+    }
+
+    if (slab == MAP_FAILED) {
+        slabSize_ = __roundUp(size, __PAGE_SIZE);
+        slab = mmap(nullptr, slabSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (slab == MAP_FAILED)
+        throw std::bad_alloc();
+
+    slab_ = static_cast<char*>(slab);
+    bufferIndex_ = ring_.registerBuffer(slab_, slabSize_);
+
+    free_.reserve(count);
+    for (size_t i = count; i > 0; i--)
+        free_.push_back(slab_ + (i - 1) * bufferSize);
+}
+
+
+BufferPool::~BufferPool() {
+    if (bufferIndex_ != -1)
+        ring_.releaseBuffer(bufferIndex_);
+
+    // Pinned by the kernel until the registration is gone: safe to unmap either way.
+    munmap(slab_, slabSize_);
+}
+
+
+void BufferPool::giveBack(char* data) {
+    std::shared_ptr<PromiseState<BufferLease>> waiter;
+    {
+        std::lock_guard _l {lock_};
+
+        while (!waiters_.empty() && waiters_.front()->status != PromiseStatus::Pending)
+            waiters_.pop_front();
+
+        if (waiters_.empty()) {
+            free_.push_back(data);
+            return;
+        }
+
+        waiter = std::move(waiters_.front());
+        waiters_.pop_front();
+    }
+
+    // Outside the lock. If the waiter got cancelled meanwhile, the lease isn't taken,
+    // and gives the buffer back again when destroyed.
+    waiter->resolve(BufferLease(this, data, bufferSize_));
+}
+
+
+std::optional<BufferLease> BufferPool::takeFree() {
+    if (free_.empty() || !waiters_.empty())
+        return std::nullopt;
+
+    char* data = free_.back();
+    free_.pop_back();
+    return BufferLease(this, data, bufferSize_);
+}
+
+
+std::optional<BufferLease> BufferPool::tryLease() {
+    std::lock_guard _l {lock_};
+    return this->takeFree();
+}
+
+
+Promise<BufferLease> BufferPool::lease() {
+    std::lock_guard _l {lock_};
+
+    if (auto lease = this->takeFree())
+        return Promise<BufferLease>::resolve(std::move(*lease));
+
+    Promise<BufferLease> ret;
+    ret.state->scheduler = &getCurrentScheduler();
+
+    ret.state->onCancel([state = ret.state.get()] () {
+        state->reject(std::make_exception_ptr(CancelledError()));
+    });
+
+    waiters_.push_back(ret.state);
+    return ret;
+}
+
+
+}  // namespace vega::io
+
+
+#endif  // defined(__linux__)
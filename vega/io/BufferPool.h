@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vega/Promise.h>
+
+
+namespace vega::io {
+
+class IoUring;
+class BufferPool;
+
+
+/**
+ * One buffer of a `BufferPool`, handed back to the pool when the lease is destroyed
+ * (or `release`d). Move-only.
+ */
+class BufferLease {
+    friend class BufferPool;
+
+protected:
+    BufferPool* pool_ = nullptr;
+    char* data_ = nullptr;
+    size_t size_ = 0;
+
+    BufferLease(BufferPool* pool, char* data, size_t size) : pool_(pool), data_(data), size_(size) {}
+
+public:
+    BufferLease() = default;
+
+    BufferLease(const BufferLease&) = delete;
+    BufferLease& operator = (const BufferLease&) = delete;
+
+    BufferLease(BufferLease&& other) noexcept
+        : pool_(std::exchange(other.pool_, nullptr)),
+        data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+
+    BufferLease& operator = (BufferLease&& other) noexcept {
+        if (this != &other) {
+            this->release();
+            pool_ = std::exchange(other.pool_, nullptr);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+
+        return *this;
+    }
+
+    ~BufferLease() { release(); }
+
+    char* data() const { return data_; }
+    size_t size() const { return size_; }
+    BufferPool* pool() const { return pool_; }
+
+    /**
+     * Give the buffer back now.
+     */
+    void release();
+
+    explicit operator bool() const { return data_ != nullptr; }
+};
+
+
+/**
+ * Fixed-size buffers carved out of one slab, which is registered with the creating thread's
+ * ring. Reads and writes into a leased buffer (the `BufferLease` overloads of `IoUringFile`
+ * and `IoUringInet4StreamSocket`) then go through io_uring_prep_read_fixed / write_fixed,
+ * and the kernel doesn't pin and map the pages on every call:
+ *
+ *     BufferPool pool(64 * 1024, 256);
+ *
+ *     auto buffer = co_await pool.lease();
+ *     size_t n = co_await file.read(buffer, buffer.size(), offset);
+ *
+ * The slab takes one slot of the ring's registered buffer table (see RingConfig's
+ * `fixedBuffers`), and registering it fails above 1 GiB. Leases used on other threads,
+ * or from a pool that couldn't be registered, fall back to plain reads and writes.
+ *
+ * Leases may be taken and given back on any thread (a coroutine holding one may resume
+ * on another worker). The pool must outlive its leases.
+ */
+class BufferPool {
+    friend class BufferLease;
+
+protected:
+    IoUring& ring_;
+
+    char* slab_ = nullptr;
+    size_t slabSize_ = 0;
+    size_t bufferSize_;
+    size_t count_;
+    bool hugePages_ = false;
+
+    /**
+     * Slot in `ring_`'s buffer table, or -1 if not registered.
+     */
+    int bufferIndex_ = -1;
+
+    /**
+     * Guards `free_` and `waiters_`.
+     */
+    mutable std::mutex lock_;
+
+    std::vector<char*> free_;
+
+    /**
+     * `lease` calls waiting for a buffer, in FIFO order.
+     */
+    std::deque<std::shared_ptr<PromiseState<BufferLease>>> waiters_;
+
+    void giveBack(char* data);
+
+    /**
+     * Must hold lock_.
+     */
+    std::optional<BufferLease> takeFree();
+
+public:
+    /**
+     * @param hugePages Back the slab with huge pages (MAP_HUGETLB), which saves the kernel
+     *                  page table walks on large pools. Falls back to normal pages if none
+     *                  are reserved (see /proc/sys/vm/nr_hugepages).
+     */
+    BufferPool(size_t bufferSize, size_t count, bool hugePages = false);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+
+    /**
+     * Lease a buffer if one is free (and nobody waits), without waiting.
+     */
+    std::optional<BufferLease> tryLease();
+
+    /**
+     * Lease a buffer, waiting (behind earlier callers) until one is given back if all are out.
+     */
+    Promise<BufferLease> lease();
+
+
+    size_t bufferSize() const { return bufferSize_; }
+    size_t count() const { return count_; }
+    size_t available() const {
+        std::lock_guard _l {lock_};
+        return free_.size();
+    }
+
+    bool hugePages() const { return hugePages_; }
+    bool registered() const { return bufferIndex_ != -1; }
+
+    /**
+     * buf_index of the slab for operations on [ring], or -1 if they have to use plain I/O.
+     */
+    int bufferIndexFor(const IoUring& ring) const {
+        return &ring == &ring_ ? bufferIndex_ : -1;
+    }
+};
+
+
+}  // namespace vega::io
+
+
+#endif  // defined(__linux__)
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+
+namespace vega::io {
+
+
+/**
+ * Result of an I/O operation that reports failures as error codes instead of throwing.
+ */
+template <typename T = std::size_t>
+using IoResult = std::expected<T, std::error_code>;
+
+
+/**
+ * Wrap an errno value (like `-cqe.res` from io_uring) as an IoResult error.
+ */
+inline std::unexpected<std::error_code> errnoError(int err) {
+    return std::unexpected(std::error_code(err, std::system_category()));
+}
+
+
+/**
+ * Thrown by I/O operations whose deadline passed. Their IoResult counterparts
+ * report std::errc::timed_out instead.
+ */
+struct TimeoutError : std::runtime_error {
+    TimeoutError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+
+}  // namespace vega::io
@@ -4,6 +4,8 @@
 
 #include <vega/io/IoUring.h>
 
+#include <cerrno>
+
 #include <vega/Scheduler.h>
 #include <vega/Promise.h>
 
@@ -11,42 +13,391 @@
 namespace vega::io {
 
 
-static thread_local uint64_t nextSqeId = 5000001ULL;
+// Even: odd user_data points to an Operation.
+static thread_local uint64_t nextSqeId = 5000002ULL;
+
+
+/**
+ * A `getSqe` call waiting for free SQEs.
+ */
+struct __GetSqeWaiter final : IoUring::SqeWaiter {
+    Promise<io_uring_sqe*> promise;
+
+    void acquired(io_uring_sqe* sqe) override {
+        auto promise = std::move(this->promise);
+        delete this;
+        promise.state->resolve(sqe);
+    }
+};
+
+
+void IoUring::queueSqeWaiter(SqeWaiter* waiter) {
+    waiter->next = nullptr;
+    if (sqeWaitersTail_)
+        sqeWaitersTail_->next = waiter;
+    else
+        sqeWaitersHead_ = waiter;
+    sqeWaitersTail_ = waiter;
+}
 
 
 size_t IoUring::drainGetSqeQueue() {
     size_t count = 0;
-    while (!getSqeQueue_.empty()) {
-        io_uring_sqe* sqe = this->ioUringGetSqe();
+    while (sqeWaitersHead_) {
+        SqeWaiter* waiter = sqeWaitersHead_;
+        io_uring_sqe* sqe = this->ioUringGetSqe(waiter->sqeCount);
         if (!sqe)
             break;
 
-        auto promise = std::move(getSqeQueue_.front());
-        getSqeQueue_.pop();
+        sqeWaitersHead_ = waiter->next;
+        if (!sqeWaitersHead_)
+            sqeWaitersTail_ = nullptr;
+
         count ++;
-        promise.state->resolve(sqe);
+        waiter->acquired(sqe);
+    }
+    return count;
+}
+
+
+IoUring::OperationBase::OperationBase(
+    IoUring& ring,
+    void (*prepare)(OperationBase*, io_uring_sqe*),
+    std::optional<std::chrono::nanoseconds> timeout
+) : ring_(ring), prepare_(prepare), timeout_(timeout) {
+    sqeCount = timeout ? 2 : 1;
+}
+
+
+bool IoUring::OperationBase::suspend(std::coroutine_handle<> handle, PromiseStateBase* parent) {
+    parent_ = parent;
+    if (parent && parent->cancelled)
+        return false;  // resume right away, to throw CancelledError.
+
+    handle_ = handle;
+    scheduler_ = &Scheduler::getCurrent();
+    userData_ = (std::uint64_t(ring_.operationSequence_++) << 48)
+        | reinterpret_cast<std::uintptr_t>(this)
+        | OPERATION_TAG;
+
+    // Not behind any tracked promise: keep the scheduler draining until it is done.
+    scheduler_->ioOperationStarted();
+    ring_.inFlightOperations_ ++;
+
+    if (parent)
+        parent->onCancel([ring = &ring_, userData = userData_] () { ring->cancel(userData); });
+
+    // Don't overtake earlier waiters.
+    io_uring_sqe* sqe = ring_.sqeWaitersHead_ ? nullptr : ring_.ioUringGetSqe(sqeCount);
+    if (sqe)
+        this->acquired(sqe);
+    else
+        ring_.queueSqeWaiter(this);
+
+    return true;
+}
+
+
+void IoUring::OperationBase::acquired(io_uring_sqe* sqe) {
+    // Cancelled while waiting for the SQE: complete through the ring all the same,
+    // so it is resumed from `poll` like any other operation.
+    if (parent_ && parent_->cancelled) {
+        io_uring_prep_nop(sqe);
+        sqe->user_data = userData_;
+        ring_.submit();
+        return;
+    }
+
+    prepare_(this, sqe);
+    sqe->user_data = userData_;
+
+    if (timeout_) {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(*timeout_);
+        timeoutSpec_.tv_sec = seconds.count();
+        timeoutSpec_.tv_nsec = (*timeout_ - seconds).count();
+
+        io_uring_sqe* timeoutSqe = io_uring_get_sqe(&ring_.ring_);  // reserved by `sqeCount`.
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_prep_link_timeout(timeoutSqe, &timeoutSpec_, 0);
+        timeoutSqe->user_data = IGNORED_TICKET;
+    }
+
+    ring_.submit();
+}
+
+
+IoUring::CompleteQueueEntry IoUring::OperationBase::resume() {
+    if (parent_) {
+        parent_->clearCancelHook();
+        __promise_details::leaveAwait(parent_);
+    }
+
+    return result_;
+}
+
+
+size_t IoUring::drainCancelRequests() {
+    if (!hasCancelRequests_.exchange(false))
+        return 0;
+
+    std::vector<std::uint64_t> tickets;
+    {
+        std::lock_guard _l {cancelRequestsLock_};
+        tickets.swap(cancelRequests_);
+    }
+
+    size_t count = 0;
+    for (auto ticket : tickets) {
+        if (this->submitCancel(ticket)) {
+            count ++;
+            continue;
+        }
+
+        std::lock_guard _l {cancelRequestsLock_};
+        cancelRequests_.push_back(ticket);
+        hasCancelRequests_ = true;
     }
+
+    if (count)
+        this->submit();
+
     return count;
 }
 
 
-io_uring_sqe* IoUring::ioUringGetSqe() {
+int IoUring::allocateFileSlot() {
+    if (fileTableState_ == 0) {
+        bool ok = fixedFiles_ > 0 && io_uring_register_files_sparse(&ring_, fixedFiles_) == 0;
+        fileTableState_ = ok ? 1 : -1;
+
+        if (ok) {
+            for (int slot = fixedFiles_ - 1; slot >= 0; slot--)
+                freeFileSlots_.push_back(slot);
+        }
+    }
+
+    if (freeFileSlots_.empty())
+        return -1;
+
+    int slot = freeFileSlots_.back();
+    freeFileSlots_.pop_back();
+    return slot;
+}
+
+
+int IoUring::registerFile(int fd) {
+    int slot = this->allocateFileSlot();
+    if (slot == -1)
+        return -1;
+
+    if (io_uring_register_files_update(&ring_, slot, &fd, 1) != 1) {
+        freeFileSlots_.push_back(slot);
+        return -1;
+    }
+
+    return slot;
+}
+
+
+void IoUring::releaseFileSlot(int slot) {
+    if (std::this_thread::get_id() != owner_) {
+        std::lock_guard _l {slotReleasesLock_};
+        slotReleases_.push_back(slot);
+        hasSlotReleases_ = true;
+        return;
+    }
+
+    int empty = -1;
+    io_uring_register_files_update(&ring_, slot, &empty, 1);
+    freeFileSlots_.push_back(slot);
+}
+
+
+int IoUring::registerBuffer(void* base, size_t size) {
+    if (bufferTableState_ == 0) {
+        bool ok = fixedBuffers_ > 0 && io_uring_register_buffers_sparse(&ring_, fixedBuffers_) == 0;
+        bufferTableState_ = ok ? 1 : -1;
+
+        if (ok) {
+            for (int slot = fixedBuffers_ - 1; slot >= 0; slot--)
+                freeBufferSlots_.push_back(slot);
+        }
+    }
+
+    if (freeBufferSlots_.empty())
+        return -1;
+
+    int slot = freeBufferSlots_.back();
+    iovec iov { .iov_base = base, .iov_len = size };
+    if (io_uring_register_buffers_update_tag(&ring_, slot, &iov, nullptr, 1) != 1)
+        return -1;
+
+    freeBufferSlots_.pop_back();
+    return slot;
+}
+
+
+void IoUring::releaseBuffer(int slot) {
+    if (std::this_thread::get_id() != owner_) {
+        std::lock_guard _l {slotReleasesLock_};
+        bufferReleases_.push_back(slot);
+        hasSlotReleases_ = true;
+        return;
+    }
+
+    iovec empty {};
+    io_uring_register_buffers_update_tag(&ring_, slot, &empty, nullptr, 1);
+    freeBufferSlots_.push_back(slot);
+}
+
+
+void IoUring::drainSlotReleases() {
+    if (!hasSlotReleases_.exchange(false))
+        return;
+
+    std::vector<int> slots;
+    std::vector<int> buffers;
+    {
+        std::lock_guard _l {slotReleasesLock_};
+        slots.swap(slotReleases_);
+        buffers.swap(bufferReleases_);
+    }
+
+    for (int slot : slots)
+        this->releaseFileSlot(slot);
+
+    for (int slot : buffers)
+        this->releaseBuffer(slot);
+}
+
+
+bool IoUring::submitCancel(std::uint64_t ticket) {
+    // Operations are not looked up: cancelling one that is over just finds nothing.
+    if (!(ticket & OPERATION_TAG) && !waitingSqes_.contains(ticket))
+        return true;  // already completed.
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (!sqe)
+        return false;
+
+    io_uring_prep_cancel64(sqe, ticket, 0);
+    sqe->user_data = IGNORED_TICKET;
+    return true;
+}
+
+
+io_uring_sqe* IoUring::ioUringGetSqe(unsigned count) {
+    // Full of queued SQEs: submit them to make room.
+    if (submitPending_ && io_uring_sq_space_left(&ring_) < count)
+        this->flush();
+
+    if (count > 1 && io_uring_sq_space_left(&ring_) < count)
+        return nullptr;
+
     io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
     if (!sqe)
         return nullptr;
 
-    sqe->user_data = nextSqeId++;
+    sqe->user_data = nextSqeId;
+    nextSqeId += 2;
     return sqe;
 }
 
 
-IoUring::IoUring(unsigned int queueDepth) {
-    auto errorcode = io_uring_queue_init(queueDepth, &ring_, 0);
+IoUring::IoUring(unsigned int queueDepth) : IoUring(RingConfig { .sqEntries = queueDepth }) {}
+
+
+/**
+ * io_uring_setup flags asked for by [config], with or without [sqpoll].
+ */
+static unsigned __setupFlags(const RingConfig& config, bool sqpoll) {
+    unsigned flags = 0;
+    if (config.cqEntries)
+        flags |= IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    if (config.singleIssuer || config.deferTaskrun)
+        flags |= IORING_SETUP_SINGLE_ISSUER;
+    if (config.attachTo >= 0)
+        flags |= IORING_SETUP_ATTACH_WQ;
+
+    // The kernel rejects the task running flags together with SQPOLL.
+    if (sqpoll) {
+        flags |= IORING_SETUP_SQPOLL;
+        if (config.sqpollCpu >= 0)
+            flags |= IORING_SETUP_SQ_AFF;
+    }
+    else {
+        if (config.coopTaskrun || config.deferTaskrun)
+            flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        if (config.deferTaskrun)
+            flags |= IORING_SETUP_DEFER_TASKRUN;
+    }
+
+    return flags;
+}
+
+
+IoUring::IoUring(const RingConfig& config) {
+    unsigned flags = __setupFlags(config, config.sqpoll);
+
+    // Dropped in this order while the kernel rejects the flags (EINVAL): newest first.
+    const unsigned optionalFlags[] = {
+        IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_SINGLE_ISSUER,
+        IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG,
+        IORING_SETUP_ATTACH_WQ,
+        IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP,
+        IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF,
+    };
+
+    unsigned droppedFlags = 0;
+    size_t next = 0;
+
+    int errorcode;
+    while (true) {
+        io_uring_params params {};
+        params.flags = flags;
+        params.cq_entries = config.cqEntries;
+        params.sq_thread_idle = config.sqpollIdle.count();
+        params.sq_thread_cpu = config.sqpollCpu;
+        params.wq_fd = config.attachTo;
+
+        errorcode = io_uring_queue_init_params(config.sqEntries, &ring_, &params);
+
+        // EPERM: not allowed to create a polling thread. Do without it (and with the task
+        // running flags it excluded), keeping everything else.
+        if (errorcode == -EPERM && (flags & IORING_SETUP_SQPOLL)) {
+            flags = __setupFlags(config, false) & ~droppedFlags;
+            next = 0;
+            continue;
+        }
+
+        if (errorcode != -EINVAL)
+            break;
+
+        while (next < std::size(optionalFlags) && !(flags & optionalFlags[next]))
+            next++;
+
+        if (next == std::size(optionalFlags))
+            break;
+
+        droppedFlags |= optionalFlags[next];
+        flags &= ~optionalFlags[next];
+        next++;
+    }
+
     if (errorcode) {
         std::string msg = "io_uring_queue_init failed: " + std::to_string(errorcode);
         throw IoUringInitError(msg);
     }
 
+    // Fails on kernels before 5.18, which is fine: io_uring_enter then looks up the fd.
+    if (config.registerRingFd)
+        ringFdRegistered_ = io_uring_register_ring_fd(&ring_) == 1;
+
+    deferTaskrun_ = ring_.flags & IORING_SETUP_DEFER_TASKRUN;
+    fixedFiles_ = config.fixedFiles;
+    fixedBuffers_ = config.fixedBuffers;
+    owner_ = std::this_thread::get_id();
     initialized_ = true;
 }
 
@@ -62,17 +413,35 @@ IoUring::~IoUring() {
 }
 
 
-Promise<io_uring_sqe*> IoUring::getSqe() {
-    io_uring_sqe* sqe = this->ioUringGetSqe();
+Promise<io_uring_sqe*> IoUring::getSqe(unsigned count) {
+    // Don't overtake earlier callers waiting for more SQEs than this one.
+    io_uring_sqe* sqe = sqeWaitersHead_ ? nullptr : this->ioUringGetSqe(count);
     if (sqe)
         return Promise<io_uring_sqe*>::resolve(sqe);
 
-    return getSqeQueue_.emplace();
+    auto waiter = new __GetSqeWaiter;
+    waiter->sqeCount = count;
+    this->queueSqeWaiter(waiter);
+    return waiter->promise;
 }
 
 
 void IoUring::submit() {
-    io_uring_submit(&ring_);
+    submitPending_ = true;
+}
+
+
+void IoUring::flush() {
+    if (!submitPending_)
+        return;
+
+    // On failure (-EBUSY while the CQ overflows, -EAGAIN, -EINTR) the SQEs stay in the SQ,
+    // and stay pending so the next flush tries again.
+    if (io_uring_submit(&ring_) < 0)
+        return;
+
+    submitPending_ = false;
+    submits_ ++;
 }
 
 
@@ -91,6 +460,8 @@ Promise<IoUring::CompleteQueueEntry> IoUring::wait(std::uint64_t ticket) {
     auto promise = (waitingSqes_[ticket] = Promise<CompleteQueueEntry>());
     Scheduler::getCurrent().track(promise);
 
+    promise.state->onCancel([this, ticket] () { this->cancel(ticket); });
+
     return promise;
 }
 
@@ -102,49 +473,81 @@ Promise<IoUring::CompleteQueueEntry> IoUring::submitAndWait(io_uring_sqe* sqe) {
 }
 
 
+Promise<IoUring::CompleteQueueEntry> IoUring::submitAndWait(io_uring_sqe* sqe, std::chrono::nanoseconds timeout) {
+    io_uring_sqe* timeoutSqe = io_uring_get_sqe(&ring_);
+    if (!timeoutSqe)
+        throw std::logic_error("IoUring::submitAndWait: no SQE left for the linked timeout. Use getSqe(2).");
+
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    auto& ts = linkTimeouts_[sqe->user_data];
+    ts.tv_sec = seconds.count();
+    ts.tv_nsec = (timeout - seconds).count();
+
+    sqe->flags |= IOSQE_IO_LINK;
+    io_uring_prep_link_timeout(timeoutSqe, &ts, 0);
+    timeoutSqe->user_data = IGNORED_TICKET;
+
+    return this->submitAndWait(sqe);
+}
+
+
 Promise<int32_t> IoUring::waitRes(uint64_t userData) {
-    co_return (co_await this->wait(userData)).res;
+    return this->wait(userData).map([] (CompleteQueueEntry cqe) { return cqe.res; });
 }
 
 
 Promise<int32_t> IoUring::submitAndWaitRes(io_uring_sqe* sqe) {
-    auto promise = this->submitAndWait(sqe);
-    co_return (co_await promise).res;
+    return this->submitAndWait(sqe).map([] (CompleteQueueEntry cqe) { return cqe.res; });
 }
 
 
-size_t IoUring::poll() {
-    size_t count = 0;
+Promise<int32_t> IoUring::submitAndWaitRes(io_uring_sqe* sqe, std::chrono::nanoseconds timeout) {
+    return this->submitAndWait(sqe, timeout).map([] (CompleteQueueEntry cqe) { return cqe.res; });
+}
 
-    std::vector<std::pair<CompleteQueueEntry, Promise<CompleteQueueEntry>>> promises;
 
-    while (true) {
-        io_uring_cqe* pCqe = nullptr;
-        auto peekResult = io_uring_peek_cqe(&ring_, &pCqe);
+void IoUring::cancel(std::uint64_t ticket) {
+    if (std::this_thread::get_id() == owner_ && this->submitCancel(ticket)) {
+        this->submit();
+        return;
+    }
 
-        if (peekResult != 0)
-            break;
+    std::lock_guard _l {cancelRequestsLock_};
+    cancelRequests_.push_back(ticket);
+    hasCancelRequests_ = true;
+}
 
-        CompleteQueueEntry cqe {
-            .res = pCqe->res,
-            .flags = pCqe->flags,
-        };
-        
-        std::uint64_t ticket = pCqe->user_data;
 
-        io_uring_cqe_seen(&ring_, pCqe);
+void IoUring::fetchCompletions() {
+    bool pending = IO_URING_READ_ONCE(*ring_.sq.kflags) & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW);
 
+    // With deferred task running, completions of operations in flight may be
+    // held back without the flag being raised.
+    if (pending || (deferTaskrun_ && (!waitingSqes_.empty() || inFlightOperations_ > 0)))
+        io_uring_get_events(&ring_);
+}
 
-        if (waitingSqes_.contains(ticket)) {
-            auto promise = waitingSqes_[ticket];
-            waitingSqes_.erase(ticket);
-            promises.emplace_back(cqe, promise);
-        }
-        else {
-            orphanCqes_[ticket] = cqe;
-        }
 
-        count ++;
+size_t IoUring::poll() {
+    this->drainCancelRequests();
+    this->drainSlotReleases();
+    this->flush();
+    this->fetchCompletions();
+
+    size_t count = 0;
+
+    std::vector<std::pair<CompleteQueueEntry, Promise<CompleteQueueEntry>>> promises;
+
+    // Completed operations, linked through `next`. Resumed once the CQ is reaped.
+    OperationBase* operationsHead = nullptr;
+    OperationBase* operationsTail = nullptr;
+
+    io_uring_cqe* batch[32];
+    while (unsigned nCqes = io_uring_peek_batch_cqe(&ring_, batch, std::size(batch))) {
+        for (unsigned i = 0; i < nCqes; i++)
+            count += this->reap(batch[i], promises, operationsHead, operationsTail);
+
+        io_uring_cq_advance(&ring_, nCqes);
     }
 
     this->drainGetSqeQueue();
@@ -152,10 +555,101 @@ size_t IoUring::poll() {
     for (auto& [cqe, promise] : promises) {
         promise.state->resolve(cqe);
     }
+
+    while (operationsHead) {
+        OperationBase* operation = operationsHead;
+        operationsHead = static_cast<OperationBase*>(operation->next);
+
+        // The operation is gone once its coroutine goes on.
+        Scheduler* scheduler = operation->scheduler_;
+        inFlightOperations_ --;
+        operation->handle_.resume();
+        scheduler->ioOperationFinished();
+    }
     
     return count;
 }
 
+
+size_t IoUring::reap(
+    io_uring_cqe* pCqe,
+    std::vector<std::pair<CompleteQueueEntry, Promise<CompleteQueueEntry>>>& promises,
+    OperationBase*& operationsHead,
+    OperationBase*& operationsTail
+) {
+    CompleteQueueEntry cqe {
+        .res = pCqe->res,
+        .flags = pCqe->flags,
+    };
+
+    std::uint64_t ticket = pCqe->user_data;
+
+    if (ticket == IGNORED_TICKET)
+        return 0;
+
+    if (ticket & OPERATION_TAG) {
+        auto operation = reinterpret_cast<OperationBase*>(ticket & OPERATION_POINTER_MASK);
+
+        // Cancelled, but not by its waiter: the linked timeout fired.
+        bool cancelled = operation->parent_ && operation->parent_->cancelled;
+        if (operation->timeout_ && cqe.res == -ECANCELED && !cancelled)
+            cqe.res = -ETIMEDOUT;
+
+        operation->result_ = cqe;
+        operation->next = nullptr;
+        if (operationsTail)
+            operationsTail->next = operation;
+        else
+            operationsHead = operation;
+        operationsTail = operation;
+
+        return 1;
+    }
+
+    bool hadLinkTimeout = linkTimeouts_.erase(ticket) > 0;
+
+    if (waitingSqes_.contains(ticket)) {
+        auto promise = waitingSqes_[ticket];
+        waitingSqes_.erase(ticket);
+
+        // Cancelled, but not by its waiter: the linked timeout fired.
+        if (hadLinkTimeout && cqe.res == -ECANCELED && !promise.state->cancelled)
+            cqe.res = -ETIMEDOUT;
+
+        promises.emplace_back(cqe, promise);
+    }
+    else {
+        if (hadLinkTimeout && cqe.res == -ECANCELED)
+            cqe.res = -ETIMEDOUT;
+
+        orphanCqes_[ticket] = cqe;
+    }
+
+    return 1;
+}
+
+bool IoUring::waitCompletion(std::chrono::nanoseconds timeout) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+
+    __kernel_timespec ts {
+        .tv_sec = seconds.count(),
+        .tv_nsec = (timeout - seconds).count(),
+    };
+
+    io_uring_cqe* cqe = nullptr;
+    int ret = io_uring_submit_and_wait_timeout(&ring_, &cqe, 1, &ts, nullptr);
+
+    // -ETIME only means nothing completed in time: the SQEs went in. Like in `flush`,
+    // they stay pending after any other error.
+    if (submitPending_ && (ret >= 0 || ret == -ETIME)) {
+        submitPending_ = false;
+        submits_ ++;
+    }
+
+    return ret >= 0;
+}
+
+
 IoUring& IoUring::getThreadIoUring() {
     return Scheduler::getThreadIoUring();
 }
@@ -7,28 +7,35 @@
 
 
 #include <string>
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <optional>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 
 #include <liburing.h>
 
+#include <vega/io/RingConfig.h>
+
 
 namespace vega {
 
 template <typename T>
 class Promise;
 class PromiseStateBase;
+class Scheduler;
 
 }  // namespace vega
 
 
 namespace vega::io {
 
-const unsigned int IO_URING_QUEUE_DEPTH = 16;
-
-
 struct IoUringInitError : std::runtime_error {
     IoUringInitError(const std::string& msg) : std::runtime_error(msg) {}
 };
@@ -41,11 +48,141 @@ public:
         std::uint32_t flags;
     };
 
+    /**
+     * Something waiting for free SQEs. Queued in the ring itself, without allocating.
+     */
+    struct SqeWaiter {
+        /**
+         * SQEs it needs at once.
+         */
+        unsigned sqeCount = 1;
+        SqeWaiter* next = nullptr;
+
+        /**
+         * Called with the first of `sqeCount` free SQEs. The others can be taken with io_uring_get_sqe.
+         */
+        virtual void acquired(io_uring_sqe* sqe) = 0;
+
+    protected:
+        ~SqeWaiter() = default;
+    };
+
+
+    /**
+     * Untyped part of `Operation`.
+     */
+    class OperationBase : public SqeWaiter {
+        friend class IoUring;
+
+    protected:
+        IoUring& ring_;
+        void (*prepare_)(OperationBase*, io_uring_sqe*);
+
+        std::optional<std::chrono::nanoseconds> timeout_;
+        __kernel_timespec timeoutSpec_ {};
+
+        /**
+         * `this`, tagged (see `OPERATION_TAG`). Set when the operation starts.
+         */
+        std::uint64_t userData_ = 0;
+
+        std::coroutine_handle<> handle_;
+
+        /**
+         * State of the awaiting coroutine, if it is a Promise coroutine. Cancelling it cancels the operation.
+         */
+        PromiseStateBase* parent_ = nullptr;
+        Scheduler* scheduler_ = nullptr;
+
+        CompleteQueueEntry result_ {};
+
+        OperationBase(IoUring& ring, void (*prepare)(OperationBase*, io_uring_sqe*), std::optional<std::chrono::nanoseconds> timeout);
+
+        /**
+         * @return False if the coroutine shouldn't suspend (it was cancelled already).
+         */
+        bool suspend(std::coroutine_handle<> handle, PromiseStateBase* parent);
+
+        void acquired(io_uring_sqe* sqe) override;
+
+        CompleteQueueEntry resume();
+    };
+
+
+    /**
+     * One io_uring operation, awaited in place:
+     *
+     *     auto cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+     *         io_uring_prep_read(sqe, fd, buffer, size, offset);
+     *     });
+     *
+     * The operation lives in the awaiting coroutine's frame, and its SQE's user_data points
+     * right at it. The completion writes the result into it and resumes the coroutine:
+     * no allocation, no lookup and no PromiseState on the way. Cancelling the awaiting
+     * coroutine cancels the operation (the coroutine then throws CancelledError).
+     *
+     * [Prep] fills in the SQE, and is called once one is free. It may set SQE flags,
+     * but not user_data. Only for operations with a single completion.
+     */
+    template <typename Prep>
+    class Operation : public OperationBase {
+    protected:
+        Prep prep_;
+
+        static void prepare(OperationBase* self, io_uring_sqe* sqe) {
+            static_cast<Operation*>(self)->prep_(sqe);
+        }
+
+    public:
+        Operation(IoUring& ring, Prep prep, std::optional<std::chrono::nanoseconds> timeout)
+            : OperationBase(ring, &Operation::prepare, timeout), prep_(std::move(prep)) {}
+
+        // Pointed to by its SQE: it must stay where it is.
+        Operation(const Operation&) = delete;
+        Operation& operator = (const Operation&) = delete;
+
+        bool await_ready() { return false; }
+
+        template <typename PromiseType>
+        bool await_suspend(std::coroutine_handle<PromiseType> h) {
+            PromiseStateBase* parent = nullptr;
+            if constexpr ( requires { h.promise().state; } )
+                parent = h.promise().state.get();
+
+            return this->suspend(h, parent);
+        }
+
+        CompleteQueueEntry await_resume() { return this->resume(); }
+    };
+
+
 protected:
     io_uring ring_;
     bool initialized_ = false;
+    bool ringFdRegistered_ = false;
 
-    std::queue<Promise<io_uring_sqe*>> getSqeQueue_;
+    /**
+     * IORING_SETUP_DEFER_TASKRUN is on: completions have to be fetched before peeking.
+     */
+    bool deferTaskrun_ = false;
+
+    /**
+     * Waiting for free SQEs, in FIFO order: operations and `getSqe` calls.
+     */
+    SqeWaiter* sqeWaitersHead_ = nullptr;
+    SqeWaiter* sqeWaitersTail_ = nullptr;
+
+    /**
+     * Operations started and not resumed yet.
+     */
+    size_t inFlightOperations_ = 0;
+
+    /**
+     * Sequence number of operations started on this ring. A few of its bits go into
+     * each operation's user_data, so a late cancel request for an operation that is
+     * over doesn't hit a new one that happens to live at the same address.
+     */
+    std::uint16_t operationSequence_ = 0;
 
     /**
      * Completed, but not waited.
@@ -57,23 +194,215 @@ protected:
      */
     std::unordered_map<std::uint64_t, Promise<CompleteQueueEntry>> waitingSqes_;
 
+    /**
+     * Timespecs of linked timeouts, by the ticket of the operation they guard.
+     * The kernel reads them at submission, which may be later than `submitAndWait` returns.
+     */
+    std::unordered_map<std::uint64_t, __kernel_timespec> linkTimeouts_;
+
+    /**
+     * Thread using this ring. Only this thread may touch the submission queue.
+     */
+    std::thread::id owner_;
+
+    /**
+     * Tickets to cancel, requested from other threads (or while the SQ was full).
+     * Submitted on next `poll`.
+     */
+    std::vector<std::uint64_t> cancelRequests_;
+    std::mutex cancelRequestsLock_;
+    std::atomic<bool> hasCancelRequests_ {false};
+
+    /**
+     * Registered file table: size asked for, and free slots (lowest on top).
+     * Set up by the first `allocateFileSlot`. `fileTableState_`: 0 not yet, 1 ready, -1 unsupported.
+     */
+    unsigned fixedFiles_ = 0;
+    int fileTableState_ = 0;
+    std::vector<int> freeFileSlots_;
+
+    /**
+     * Registered buffer table, like the file table.
+     */
+    unsigned fixedBuffers_ = 0;
+    int bufferTableState_ = 0;
+    std::vector<int> freeBufferSlots_;
+
+    /**
+     * File and buffer slots released from other threads. Emptied on next `poll`.
+     */
+    std::vector<int> slotReleases_;
+    std::vector<int> bufferReleases_;
+    std::mutex slotReleasesLock_;
+    std::atomic<bool> hasSlotReleases_ {false};
+
+    /**
+     * SQEs were queued by `submit` since the last `flush`.
+     */
+    bool submitPending_ = false;
+    size_t submits_ = 0;
+
+    void queueSqeWaiter(SqeWaiter* waiter);
+
+    /**
+     * Take one CQE: queue the operation or promise it completes. Returns 1 if it completed something.
+     */
+    size_t reap(
+        io_uring_cqe* cqe,
+        std::vector<std::pair<CompleteQueueEntry, Promise<CompleteQueueEntry>>>& promises,
+        OperationBase*& operationsHead,
+        OperationBase*& operationsTail
+    );
     size_t drainGetSqeQueue();
-    io_uring_sqe* ioUringGetSqe();
+    size_t drainCancelRequests();
+    void drainSlotReleases();
+    /**
+     * Get a SQE if [count] are free, so the caller can take the other [count] - 1
+     * with io_uring_get_sqe right after.
+     */
+    io_uring_sqe* ioUringGetSqe(unsigned count = 1);
+
+    /**
+     * Submit IORING_OP_ASYNC_CANCEL for [ticket]. Returns false if no SQE is available.
+     */
+    bool submitCancel(std::uint64_t ticket);
+
+    /**
+     * Have the kernel post completions it is holding back (see RingConfig's
+     * `coopTaskrun` and `deferTaskrun`), if there are any.
+     */
+    void fetchCompletions();
 
     io_uring_cqe copy(io_uring_cqe& cqe);
     io_uring_cqe copy(io_uring_cqe* cqe);
 
 public:
 
+    /**
+     * user_data of SQEs whose completions nobody waits for (like async cancel requests).
+     */
+    static constexpr std::uint64_t IGNORED_TICKET = 0;
+
+    /**
+     * Low bit of user_data set: it points to an Operation (whose address is aligned, so the
+     * bit is free). `wait` tickets keep it clear. The top 16 bits hold a sequence number,
+     * as user-space addresses fit in the low 48 bits.
+     */
+    static constexpr std::uint64_t OPERATION_TAG = 1;
+    static constexpr std::uint64_t OPERATION_POINTER_MASK = ((std::uint64_t(1) << 48) - 1) & ~OPERATION_TAG;
+
     IoUring(unsigned int queueDepth = IO_URING_QUEUE_DEPTH);
+    explicit IoUring(const RingConfig& config);
     virtual ~IoUring();
 
     io_uring& ring() { return ring_; }
 
-    Promise<io_uring_sqe*> getSqe();
+    /**
+     * IORING_SETUP_* flags the ring was set up with (what the kernel accepted of the config).
+     */
+    unsigned setupFlags() const { return ring_.flags; }
+
+    unsigned sqEntries() const { return ring_.sq.ring_entries; }
+    unsigned cqEntries() const { return ring_.cq.ring_entries; }
+
+    bool ringFdRegistered() const { return ringFdRegistered_; }
+
+
+    /*
+     * Registered file table (see RingConfig's `fixedFiles`). A slot only means something
+     * to this ring: operations on other threads' rings have to use the fd itself.
+     * See `RingFd`, which does the bookkeeping for files and sockets.
+     */
+
+    /**
+     * Take a free slot, to register a file in, or to have an operation create a direct
+     * descriptor in (like io_uring_prep_openat_direct). Owner thread only.
+     *
+     * @return The slot, or -1 if the table is full or the kernel has none.
+     */
+    int allocateFileSlot();
+
+    /**
+     * Put [fd] in a free slot. The fd stays open and owned by the caller. Owner thread only.
+     *
+     * @return The slot, or -1 if there is none.
+     */
+    int registerFile(int fd);
+
+    /**
+     * Empty [slot] (closing the direct descriptor in it, if any) and take it back.
+     * Operations using it still complete. May be called from any thread.
+     */
+    void releaseFileSlot(int slot);
+
+    /**
+     * Slots in use.
+     */
+    size_t registeredFiles() const {
+        return fileTableState_ == 1 ? fixedFiles_ - freeFileSlots_.size() : 0;
+    }
+
+
+    /*
+     * Registered buffer table (see RingConfig's `fixedBuffers`). Read and write with
+     * io_uring_prep_read_fixed / write_fixed into a registered buffer skip pinning and
+     * mapping its pages on each operation. See `BufferPool`.
+     */
+
+    /**
+     * Register [size] bytes at [base] (at most 1 GiB) in a free slot. Owner thread only.
+     *
+     * @return The slot (the buf_index to use), or -1 if the table is full or the kernel has none.
+     */
+    int registerBuffer(void* base, size_t size);
+
+    /**
+     * Empty buffer [slot]. Operations using it still complete. May be called from any thread.
+     */
+    void releaseBuffer(int slot);
+
+    size_t registeredBuffers() const {
+        return bufferTableState_ == 1 ? fixedBuffers_ - freeBufferSlots_.size() : 0;
+    }
 
+    /**
+     * Operation preparing its SQE with [prep] (io_uring_sqe*), to be co_awaited right away.
+     * See `Operation`.
+     *
+     * @param timeout Deadline, enforced with a linked timeout like `submitAndWait`'s.
+     *                The result is -ETIMEDOUT if it passes.
+     */
+    template <typename Prep>
+    Operation<Prep> operation(Prep prep, std::optional<std::chrono::nanoseconds> timeout = std::nullopt) {
+        return Operation<Prep>(*this, std::move(prep), timeout);
+    }
+
+    /**
+     * Get a SQE, waiting for one to be free if the submission queue is full.
+     *
+     * @param count SQEs to reserve. With 2, the SQE can be submitted with a linked timeout
+     *              (see `submitAndWait` with a timeout).
+     */
+    Promise<io_uring_sqe*> getSqe(unsigned count = 1);
+
+    /**
+     * Queue the SQEs prepared so far for submission. They go to the kernel together, in
+     * one io_uring_enter, on the next `poll` (once per scheduler loop iteration), when the
+     * submission queue is full, or on `flush`, whichever comes first.
+     */
     void submit();
 
+    /**
+     * Submit queued SQEs now, for latency-sensitive callers that shouldn't wait for the
+     * end of the scheduler's loop iteration.
+     */
+    void flush();
+
+    /**
+     * Times queued SQEs were actually submitted. For diagnostics.
+     */
+    size_t submits() const { return submits_; }
+
     /**
      * Wait for the result of an already submitted SQE.
      *
@@ -82,10 +411,19 @@ public:
     Promise<CompleteQueueEntry> wait(std::uint64_t);
 
     /**
-     * Submit a SQE and wait for its result. 
+     * Submit a SQE (queued, see `submit`) and wait for its result.
      */
     Promise<CompleteQueueEntry> submitAndWait(io_uring_sqe*);
 
+    /**
+     * Submit a SQE with a deadline, and wait for its result. The SQE is linked to an
+     * IORING_OP_LINK_TIMEOUT, so the kernel itself aborts it after [timeout];
+     * it then completes with -ETIMEDOUT. No user-space timer is involved.
+     *
+     * The SQE must come from `getSqe(2)`, which leaves room for the timeout's SQE.
+     */
+    Promise<CompleteQueueEntry> submitAndWait(io_uring_sqe*, std::chrono::nanoseconds timeout);
+
     /**
      * Wait for the result of an already submitted SQE, and get result.res code.
      * 
@@ -97,10 +435,34 @@ public:
      * Submit a SQE and wait for its result.res code. 
      */
     Promise<int32_t> submitAndWaitRes(io_uring_sqe*);
+
+    /**
+     * Like `submitAndWait` with a timeout, but get result.res code.
+     */
+    Promise<int32_t> submitAndWaitRes(io_uring_sqe*, std::chrono::nanoseconds timeout);
+
+    /**
+     * Cancel an in-flight SQE with IORING_OP_ASYNC_CANCEL. Its waiter then resolves
+     * with -ECANCELED (or with its real result, if it completed first).
+     *
+     * Promises returned by `wait` call this when they are cancelled.
+     * May be called from any thread.
+     *
+     * @param sqe.user_data
+     */
+    void cancel(std::uint64_t);
     
 
     size_t poll();
 
+    /**
+     * Submit queued SQEs, then block until a completion is available (without consuming it)
+     * or [timeout] passes, all in one io_uring_enter. For idle waits that should still wake up on I/O.
+     *
+     * @return True if a completion is available.
+     */
+    bool waitCompletion(std::chrono::nanoseconds timeout);
+
     static IoUring& getThreadIoUring();
 
 };
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#include <chrono>
+
+
+namespace vega::io {
+
+
+/**
+ * Default submission queue size of a thread's io_uring.
+ */
+const unsigned int IO_URING_QUEUE_DEPTH = 256;
+
+
+/**
+ * How an IoUring is set up. Set one on a scheduler with `Scheduler::setRingConfig`.
+ *
+ * Setup flags the kernel doesn't know (EINVAL) are dropped one by one, newest first,
+ * so the same config works on older kernels, just without the newer optimizations.
+ * `IoUring::setupFlags()` tells what was actually applied.
+ */
+struct RingConfig {
+    /**
+     * Submission queue size. Rounded up to a power of two by the kernel.
+     */
+    unsigned int sqEntries = IO_URING_QUEUE_DEPTH;
+
+    /**
+     * Completion queue size (IORING_SETUP_CQSIZE). 0 keeps the kernel's default of twice
+     * `sqEntries`. A larger CQ helps when many operations complete between two polls.
+     */
+    unsigned int cqEntries = 0;
+
+    /**
+     * IORING_SETUP_SINGLE_ISSUER (6.0): only the creating thread submits, which rings
+     * of this library are anyway. Lets the kernel skip some locking.
+     */
+    bool singleIssuer = true;
+
+    /**
+     * IORING_SETUP_COOP_TASKRUN (5.19): completions don't interrupt the thread with an IPI,
+     * but are posted the next time it enters the kernel. `poll` enters when the kernel
+     * flags (IORING_SETUP_TASKRUN_FLAG) that completions are waiting.
+     */
+    bool coopTaskrun = true;
+
+    /**
+     * IORING_SETUP_DEFER_TASKRUN (6.1): completions are only posted when the thread asks for
+     * them, in batches. Cheapest for a thread that polls in a loop, as the thread's rings here
+     * do. Implies `singleIssuer`.
+     */
+    bool deferTaskrun = false;
+
+    /**
+     * Register the ring's fd with the thread (5.18), so io_uring_enter skips the fd lookup.
+     */
+    bool registerRingFd = true;
+
+    /**
+     * Slots in the ring's registered file table (sparse, 5.19). Files registered there
+     * (`IoUringFile::registerFd`, direct descriptors) spare the kernel an fget/fput
+     * per operation. The table is set up at first use. 0 for none.
+     */
+    unsigned int fixedFiles = 1024;
+
+    /**
+     * Slots in the ring's registered buffer table (sparse, 5.19). Each `BufferPool`
+     * takes one. Set up at first use. 0 for none.
+     */
+    unsigned int fixedBuffers = 16;
+
+    /**
+     * IORING_SETUP_SQPOLL: a kernel thread polls the submission queue, so submitting
+     * needs no syscall while it is awake. It burns a core while polling, so it only pays
+     * off on busy I/O paths.
+     *
+     * A scheduler creates one anchor ring with this config, and attaches all its threads'
+     * rings to it (IORING_SETUP_ATTACH_WQ), so they share a single polling thread.
+     * Doesn't go with `coopTaskrun` or `deferTaskrun`, which are ignored then.
+     * Without permission for SQPOLL (or on kernels before 5.11, which require root),
+     * rings fall back to normal submission, with those two flags and the others intact.
+     */
+    bool sqpoll = false;
+
+    /**
+     * How long the polling thread spins without work before it goes to sleep.
+     * The next submission then takes a syscall to wake it up.
+     */
+    std::chrono::milliseconds sqpollIdle {1000};
+
+    /**
+     * CPU to pin the polling thread to (IORING_SETUP_SQ_AFF), or -1 not to pin it.
+     */
+    int sqpollCpu = -1;
+
+    /**
+     * Fd of a ring to share the kernel's async workers and polling thread with
+     * (IORING_SETUP_ATTACH_WQ), or -1. Schedulers set this in `sqpoll` mode.
+     */
+    int attachTo = -1;
+};
+
+
+}  // namespace vega::io
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#if defined(__linux__)
+
+#include <vega/io/RingFd.h>
+
+#include <unistd.h>
+
+#include <vega/io/IoUring.h>
+
+
+namespace vega::io {
+
+
+bool RingFd::registerWith(IoUring& ring) {
+    if (slot_ != -1)
+        return ring_ == &ring;
+
+    if (fd_ == -1)
+        return false;
+
+    int slot = ring.registerFile(fd_);
+    if (slot == -1)
+        return false;
+
+    slot_ = slot;
+    ring_ = &ring;
+    return true;
+}
+
+
+void RingFd::adoptDirect(IoUring& ring, int slot) {
+    this->close();
+    slot_ = slot;
+    ring_ = &ring;
+}
+
+
+void RingFd::close() {
+    if (slot_ != -1) {
+        ring_->releaseFileSlot(slot_);
+        slot_ = -1;
+        ring_ = nullptr;
+    }
+
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+
+}  // namespace vega::io
+
+
+#endif  // defined(__linux__)
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MulanPSL-2.0
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <utility>
+
+#include <liburing.h>
+
+
+namespace vega::io {
+
+class IoUring;
+
+
+/**
+ * A file descriptor owned by a file or socket, and its slot in one ring's registered
+ * file table if it has one:
+ *
+ *   - Plain: only an fd.
+ *   - Registered (`registerWith`): an fd, and a slot on one ring. Operations on that ring
+ *     use the slot (IOSQE_FIXED_FILE), which spares the kernel an fget/fput each time.
+ *     Other rings use the fd.
+ *   - Direct (`adoptDirect`): only a slot, created by an io_uring operation (like
+ *     io_uring_prep_openat_direct). Usable on its ring only.
+ *
+ * Closing releases the slot and closes the fd. A registered or direct RingFd must be
+ * closed before its ring goes away, which for a thread's ring is when the thread exits.
+ */
+class RingFd {
+protected:
+    int fd_ = -1;
+    int slot_ = -1;
+    IoUring* ring_ = nullptr;
+
+public:
+    RingFd() = default;
+    explicit RingFd(int fd) : fd_(fd) {}
+
+    RingFd(const RingFd&) = delete;
+    RingFd& operator = (const RingFd&) = delete;
+
+    RingFd(RingFd&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)),
+        slot_(std::exchange(other.slot_, -1)),
+        ring_(std::exchange(other.ring_, nullptr)) {}
+
+    RingFd& operator = (RingFd&& other) noexcept {
+        if (this != &other) {
+            this->close();
+            fd_ = std::exchange(other.fd_, -1);
+            slot_ = std::exchange(other.slot_, -1);
+            ring_ = std::exchange(other.ring_, nullptr);
+        }
+
+        return *this;
+    }
+
+    ~RingFd() { close(); }
+
+    /**
+     * -1 for a direct descriptor.
+     */
+    int fd() const { return fd_; }
+    int slot() const { return slot_; }
+    IoUring* ring() const { return ring_; }
+
+    bool isValid() const { return fd_ != -1 || slot_ != -1; }
+    bool isRegistered() const { return slot_ != -1; }
+    bool isDirect() const { return fd_ == -1 && slot_ != -1; }
+
+    /**
+     * Register the fd in a free slot of [ring].
+     *
+     * @return False if there is no free slot, or if it is registered on another ring already.
+     */
+    bool registerWith(IoUring& ring);
+
+    /**
+     * Take over the direct descriptor in [slot] of [ring], closing what this held.
+     */
+    void adoptDirect(IoUring& ring, int slot);
+
+    /**
+     * Whether operations on [ring] can use this: anything but a direct descriptor of another ring.
+     */
+    bool usableOn(IoUring& ring) const {
+        return fd_ != -1 || (slot_ != -1 && ring_ == &ring);
+    }
+
+    /**
+     * Point [sqe], just prepared with `fd()`, at the file for [ring]: through its slot
+     * if it has one there. Must be `usableOn` [ring].
+     */
+    void apply(io_uring_sqe* sqe, IoUring& ring) const {
+        if (slot_ != -1 && ring_ == &ring) {
+            sqe->fd = slot_;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+    }
+
+    void close();
+};
+
+
+}  // namespace vega::io
+
+
+#endif  // defined(__linux__)
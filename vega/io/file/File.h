@@ -7,6 +7,8 @@
 #include <vector>
 
 #include <vega/Promise.h>
+#include <vega/AsyncGenerator.h>
+#include <vega/io/IoResult.h>
 #include <vega/io/file/FileOpenMode.h>
 
 
@@ -45,6 +47,16 @@ public:
 
     virtual Promise<std::size_t> read(void* buffer, std::size_t size, long offset = -1) = 0;
     virtual Promise<std::size_t> write(const void* buffer, std::size_t size, long offset = -1) = 0;
+
+    /**
+     * Like `read`, but failures are returned as error codes instead of thrown.
+     */
+    virtual Promise<IoResult<>> tryRead(void* buffer, std::size_t size, long offset = -1) = 0;
+
+    /**
+     * Like `write`, but failures are returned as error codes instead of thrown.
+     */
+    virtual Promise<IoResult<>> tryWrite(const void* buffer, std::size_t size, long offset = -1) = 0;
     
     // -------- Convenience APIs --------
 
@@ -56,6 +68,33 @@ public:
         return this->write(buf.data(), buf.size(), offset);
     }
 
+    Promise<IoResult<>> tryRead(std::vector<char>& buf, long offset = -1) {
+        return this->tryRead(buf.data(), buf.size(), offset);
+    }
+
+    Promise<IoResult<>> tryWrite(const std::vector<char>& buf, long offset = -1) {
+        return this->tryWrite(buf.data(), buf.size(), offset);
+    }
+
+    /**
+     * Stream the file in chunks of at most [chunkSize] bytes, starting at [offset],
+     * until end of file. The next chunk is only read once the consumer asks for it.
+     *
+     * The file must stay open while the generator is in use.
+     */
+    AsyncGenerator<std::vector<char>> readChunks(std::size_t chunkSize, long offset = 0) {
+        while (true) {
+            std::vector<char> chunk(chunkSize);
+            auto n = co_await this->read(chunk.data(), chunkSize, offset);
+            if (n == 0)
+                co_return;
+
+            offset += n;
+            chunk.resize(n);
+            co_yield std::move(chunk);
+        }
+    }
+
     operator bool() const { return this->isOpen(); } 
 };
 
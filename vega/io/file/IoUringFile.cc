@@ -13,23 +13,8 @@
 
 namespace vega::io {
 
-IoUringFile::IoUringFile(IoUringFile&& other) {
-    fd_ = other.fd_;
-    other.fd_ = -1;
-}
-
 
-IoUringFile& IoUringFile::operator = (IoUringFile&& other) {
-    if (this != &other) {
-        this->fd_ = other.fd_;
-        other.fd_ = -1;
-    }
-    
-    return *this;
-}
-
-
-bool IoUringFile::open(const std::string& path, FileOpenMode mode) {
+static int __openFlags(FileOpenMode mode) {
     int flags = 0;
 
 
@@ -44,36 +29,100 @@ bool IoUringFile::open(const std::string& path, FileOpenMode mode) {
         flags |= O_TRUNC;
 
     flags |= O_CREAT;
+
+    return flags;
+}
+
+
+/**
+ * Throw if [fd] is a direct descriptor of a ring other than [ring].
+ */
+static void __checkRing(const RingFd& fd, IoUring& ring) {
+    if (!fd.usableOn(ring))
+        throw std::logic_error("IoUringFile: direct descriptor used from another thread");
+}
+
+
+IoUringFile::IoUringFile(IoUringFile&& other) : fd_(std::move(other.fd_)) {}
+
+
+IoUringFile& IoUringFile::operator = (IoUringFile&& other) {
+    if (this != &other) {
+        this->fd_ = std::move(other.fd_);
+    }
     
-    
-    fd_ = ::open(path.c_str(), flags, 0644);
-    if (fd_ == -1) {
-        return false;
+    return *this;
+}
+
+
+bool IoUringFile::open(const std::string& path, FileOpenMode mode) {
+    fd_ = RingFd(::open(path.c_str(), __openFlags(mode), 0644));
+    return fd_.isValid();
+}
+
+
+bool IoUringFile::registerFd() {
+    return fd_.registerWith(IoUring::getThreadIoUring());
+}
+
+
+Promise<bool> IoUringFile::openDirect(const std::string& path, FileOpenMode mode) {
+    this->close();
+
+    auto& ring = IoUring::getThreadIoUring();
+    int slot = ring.allocateFileSlot();
+    if (slot == -1)
+        co_return false;
+
+    std::string pathCopy = path;
+    int flags = __openFlags(mode);
+
+    IoUring::CompleteQueueEntry cqe;
+    try {
+        cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+            io_uring_prep_openat_direct(sqe, AT_FDCWD, pathCopy.c_str(), flags, 0644, slot);
+        });
+    }
+    catch (...) {
+        // Cancelled: the file may be open in the slot all the same.
+        ring.releaseFileSlot(slot);
+        throw;
+    }
+
+    if (cqe.res < 0) {
+        ring.releaseFileSlot(slot);
+        co_return false;
     }
 
-    return true;
+    fd_.adoptDirect(ring, slot);
+    co_return true;
 }
 
 
 void IoUringFile::close() {
-    if (isOpen()) {
-        ::close(fd_);
-        fd_ = -1;
-    }
+    fd_.close();
 }
 
 
-Promise<size_t> IoUringFile::read(void* buffer, size_t size, long offset) {
+Promise<IoResult<>> IoUringFile::tryReadImpl(void* buffer, size_t size, long offset, Timeout timeout, const BufferPool* pool) {
     if (offset == -1)
         offset = readPos_;
 
-    io_uring_sqe* sqe = co_await IoUring::getThreadIoUring().getSqe();
+    auto& ring = IoUring::getThreadIoUring();
+    __checkRing(fd_, ring);
+
+    int bufferIndex = pool ? pool->bufferIndexFor(ring) : -1;
 
-    io_uring_prep_read(sqe, fd_, buffer, size, offset);
-    auto ret = co_await IoUring::getThreadIoUring().submitAndWait(sqe);
+    auto ret = co_await ring.operation([&] (io_uring_sqe* sqe) {
+        if (bufferIndex != -1)
+            io_uring_prep_read_fixed(sqe, fd_.fd(), buffer, size, offset, bufferIndex);
+        else
+            io_uring_prep_read(sqe, fd_.fd(), buffer, size, offset);
+        fd_.apply(sqe, ring);
+    }, timeout);
 
     if (ret.res < 0)
-        throw std::runtime_error("read failed (IoUringFile)");
+        co_return errnoError(-ret.res);
 
     readPos_ = offset + ret.res;
     
@@ -81,18 +130,25 @@ Promise<size_t> IoUringFile::read(void* buffer, size_t size, long offset) {
 }
 
 
-Promise<size_t> IoUringFile::write(const void* buffer, size_t size, long offset) {
+Promise<IoResult<>> IoUringFile::tryWriteImpl(const void* buffer, size_t size, long offset, Timeout timeout, const BufferPool* pool) {
     if (offset == -1)
         offset = writePos_;
 
-    io_uring_sqe* sqe = co_await IoUring::getThreadIoUring().getSqe();
-    
-    io_uring_prep_write(sqe, fd_, buffer, size, offset);
+    auto& ring = IoUring::getThreadIoUring();
+    __checkRing(fd_, ring);
+
+    int bufferIndex = pool ? pool->bufferIndexFor(ring) : -1;
 
-    auto ret = co_await IoUring::getThreadIoUring().submitAndWait(sqe);
+    auto ret = co_await ring.operation([&] (io_uring_sqe* sqe) {
+        if (bufferIndex != -1)
+            io_uring_prep_write_fixed(sqe, fd_.fd(), buffer, size, offset, bufferIndex);
+        else
+            io_uring_prep_write(sqe, fd_.fd(), buffer, size, offset);
+        fd_.apply(sqe, ring);
+    }, timeout);
 
     if (ret.res < 0)
-        throw std::runtime_error("read failed (IoUringFile)");
+        co_return errnoError(-ret.res);
 
     writePos_ = offset + ret.res;
     
@@ -100,6 +156,81 @@ Promise<size_t> IoUringFile::write(const void* buffer, size_t size, long offset)
 }
 
 
+Promise<size_t> IoUringFile::read(void* buffer, size_t size, long offset) {
+    return this->tryRead(buffer, size, offset).map([] (IoResult<> ret) {
+        if (!ret)
+            throw std::runtime_error("read failed (IoUringFile): " + ret.error().message());
+
+        return *ret;
+    });
+}
+
+
+Promise<size_t> IoUringFile::write(const void* buffer, size_t size, long offset) {
+    return this->tryWrite(buffer, size, offset).map([] (IoResult<> ret) {
+        if (!ret)
+            throw std::runtime_error("write failed (IoUringFile): " + ret.error().message());
+
+        return *ret;
+    });
+}
+
+
+static size_t __valueOrThrow(IoResult<> ret, const char* what) {
+    if (ret)
+        return *ret;
+
+    if (ret.error() == std::errc::timed_out)
+        throw TimeoutError(std::string(what) + " timed out (IoUringFile)");
+    throw std::runtime_error(std::string(what) + " failed (IoUringFile): " + ret.error().message());
+}
+
+
+Promise<size_t> IoUringFile::read(void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout) {
+    return this->tryReadImpl(buffer, size, offset, timeout).map([] (IoResult<> ret) {
+        return __valueOrThrow(std::move(ret), "read");
+    });
+}
+
+
+Promise<size_t> IoUringFile::write(const void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout) {
+    return this->tryWriteImpl(buffer, size, offset, timeout).map([] (IoResult<> ret) {
+        return __valueOrThrow(std::move(ret), "write");
+    });
+}
+
+
+
+Promise<IoResult<>> IoUringFile::tryRead(BufferLease& buffer, size_t size, long offset) {
+    if (size > buffer.size())
+        return Promise<IoResult<>>::reject(std::length_error("IoUringFile: reading past the leased buffer"));
+
+    return this->tryReadImpl(buffer.data(), size, offset, std::nullopt, buffer.pool());
+}
+
+
+Promise<IoResult<>> IoUringFile::tryWrite(const BufferLease& buffer, size_t size, long offset) {
+    if (size > buffer.size())
+        return Promise<IoResult<>>::reject(std::length_error("IoUringFile: writing past the leased buffer"));
+
+    return this->tryWriteImpl(buffer.data(), size, offset, std::nullopt, buffer.pool());
+}
+
+
+Promise<size_t> IoUringFile::read(BufferLease& buffer, size_t size, long offset) {
+    return this->tryRead(buffer, size, offset).map([] (IoResult<> ret) {
+        return __valueOrThrow(std::move(ret), "read");
+    });
+}
+
+
+Promise<size_t> IoUringFile::write(const BufferLease& buffer, size_t size, long offset) {
+    return this->tryWrite(buffer, size, offset).map([] (IoResult<> ret) {
+        return __valueOrThrow(std::move(ret), "write");
+    });
+}
+
+
 }  // namespace vega::io
 
 #endif // defined(__linux__)
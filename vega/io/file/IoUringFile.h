@@ -5,8 +5,13 @@
 
 #if defined(__linux__)
 
+#include <chrono>
+#include <optional>
+
 #include <liburing.h>
 #include <vega/io/file/File.h>
+#include <vega/io/RingFd.h>
+#include <vega/io/BufferPool.h>
 
 
 namespace vega::io {
@@ -16,10 +21,18 @@ class IoUring;
 
 class IoUringFile : public File {
 protected:
-    int fd_ = -1;
+    RingFd fd_;
 
     IoUring& threadIoUring();
 
+    using Timeout = std::optional<std::chrono::nanoseconds>;
+
+    /**
+     * @param pool Pool [buffer] belongs to, to read or write it as a registered buffer.
+     */
+    Promise<IoResult<>> tryReadImpl(void* buffer, size_t size, long offset, Timeout timeout, const BufferPool* pool = nullptr);
+    Promise<IoResult<>> tryWriteImpl(const void* buffer, size_t size, long offset, Timeout timeout, const BufferPool* pool = nullptr);
+
 
 public:
     IoUringFile() {}
@@ -32,13 +45,75 @@ public:
     virtual bool open(const std::string& path, FileOpenMode mode) override;
 
     virtual bool isOpen() const override {
-        return fd_ != -1;
+        return fd_.isValid();
     }
 
     virtual void close() override;
 
+
+    /**
+     * Register the open file with this thread's ring (see `RingFd`), so operations
+     * from this thread skip the kernel's per-operation file lookup.
+     *
+     * @return False if the ring's file table is full or unsupported. The file works all the same.
+     */
+    bool registerFd();
+
+    /**
+     * Open [path] as a direct descriptor of this thread's ring (io_uring_prep_openat_direct):
+     * registered from the start, with no fd at all. It can then only be read and written
+     * from this thread; other threads get std::logic_error.
+     *
+     * @return False if the file can't be opened, or the ring has no free slot.
+     */
+    Promise<bool> openDirect(const std::string& path, FileOpenMode mode);
+
+    /**
+     * The fd, or -1 if the file is a direct descriptor.
+     */
+    int fd() const { return fd_.fd(); }
+
+
+    /*
+     * Variants reading into and writing from a leased buffer (see `BufferPool`), with
+     * io_uring_prep_read_fixed / write_fixed if the pool is registered with this thread's
+     * ring. [size] is at most the lease's size.
+     */
+
+    Promise<size_t> read(BufferLease& buffer, size_t size, long offset = -1);
+    Promise<size_t> write(const BufferLease& buffer, size_t size, long offset = -1);
+    Promise<IoResult<>> tryRead(BufferLease& buffer, size_t size, long offset = -1);
+    Promise<IoResult<>> tryWrite(const BufferLease& buffer, size_t size, long offset = -1);
+
     virtual Promise<size_t> read(void* buffer, size_t size, long offset = -1) override;
     virtual Promise<size_t> write(const void* buffer, size_t size, long offset = -1) override;
+
+    virtual Promise<IoResult<>> tryRead(void* buffer, size_t size, long offset = -1) override {
+        return tryReadImpl(buffer, size, offset, std::nullopt);
+    }
+
+    virtual Promise<IoResult<>> tryWrite(const void* buffer, size_t size, long offset = -1) override {
+        return tryWriteImpl(buffer, size, offset, std::nullopt);
+    }
+
+
+    /*
+     * Variants with a deadline. The kernel aborts the operation once [timeout] passes
+     * (see IoUring::submitAndWait), and it fails with TimeoutError, or std::errc::timed_out
+     * for the try- variants. Regular files complete right away; this is for pipes, FIFOs
+     * and character devices.
+     */
+
+    Promise<size_t> read(void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout);
+    Promise<size_t> write(const void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout);
+
+    Promise<IoResult<>> tryRead(void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout) {
+        return tryReadImpl(buffer, size, offset, timeout);
+    }
+
+    Promise<IoResult<>> tryWrite(const void* buffer, size_t size, long offset, std::chrono::nanoseconds timeout) {
+        return tryWriteImpl(buffer, size, offset, timeout);
+    }
 };
 
 }  // namespace vega::io
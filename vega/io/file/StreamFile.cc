@@ -4,6 +4,7 @@
 #include <vega/Promise.h>
 #include <vega/io/file/StreamFile.h>
 
+#include <cerrno>
 #include <filesystem>
 
 
@@ -43,7 +44,7 @@ bool StreamFile::open(const std::string& path, FileOpenMode mode) {
 
 
 
-Promise<size_t> StreamFile::read(void *buffer, size_t size, long offset) {
+size_t StreamFile::readNow(void* buffer, size_t size, long offset) {
     if (offset == -1)
         offset = this->readPos_;
 
@@ -53,11 +54,11 @@ Promise<size_t> StreamFile::read(void *buffer, size_t size, long offset) {
     
     this->readPos_ = this->stream_.tellg();
         
-    return Promise<size_t>::resolve(this->stream_.gcount());
+    return this->stream_.gcount();
 }
 
 
-Promise<size_t> StreamFile::write(const void *buffer, size_t size, long offset) {
+size_t StreamFile::writeNow(const void* buffer, size_t size, long offset) {
     if (offset == -1)
         offset = this->writePos_;
     
@@ -67,7 +68,35 @@ Promise<size_t> StreamFile::write(const void *buffer, size_t size, long offset)
     this->stream_.write(static_cast<const char*>(buffer), size);
     this->writePos_ = this->stream_.tellp();
         
-    return Promise<size_t>::resolve(this->writePos_ - posBefore);
+    return this->writePos_ - posBefore;
+}
+
+
+Promise<size_t> StreamFile::read(void *buffer, size_t size, long offset) {
+    return Promise<size_t>::resolve(this->readNow(buffer, size, offset));
+}
+
+
+Promise<size_t> StreamFile::write(const void *buffer, size_t size, long offset) {
+    return Promise<size_t>::resolve(this->writeNow(buffer, size, offset));
+}
+
+
+Promise<IoResult<>> StreamFile::tryRead(void *buffer, size_t size, long offset) {
+    size_t n = this->readNow(buffer, size, offset);
+    if (this->stream_.bad())
+        return Promise<IoResult<>>::resolve(errnoError(EIO));
+
+    return Promise<IoResult<>>::resolve(n);
+}
+
+
+Promise<IoResult<>> StreamFile::tryWrite(const void *buffer, size_t size, long offset) {
+    size_t n = this->writeNow(buffer, size, offset);
+    if (this->stream_.bad())
+        return Promise<IoResult<>>::resolve(errnoError(EIO));
+
+    return Promise<IoResult<>>::resolve(n);
 }
 
 
@@ -14,6 +14,9 @@ class StreamFile : public File {
 protected:
     std::fstream stream_;
 
+    size_t readNow(void* buffer, size_t size, long offset);
+    size_t writeNow(const void* buffer, size_t size, long offset);
+
 public:
     StreamFile() {}
 
@@ -33,6 +36,9 @@ public:
 
     virtual Promise<size_t> read(void* buffer, size_t size, long offset = -1) override;
     virtual Promise<size_t> write(const void* buffer, size_t size, long offset = -1) override;
+
+    virtual Promise<IoResult<>> tryRead(void* buffer, size_t size, long offset = -1) override;
+    virtual Promise<IoResult<>> tryWrite(const void* buffer, size_t size, long offset = -1) override;
 };
 
 
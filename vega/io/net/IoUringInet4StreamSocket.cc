@@ -6,6 +6,7 @@
 
 #include <vega/Scheduler.h>
 
+#include <cerrno>
 #include <cstring>
 
 #include <sys/socket.h>
@@ -30,18 +31,67 @@ static int __tryCreateSocket() {
 }
 
 
-Promise<> IoUringInet4StreamSocket::connect(const Inet4Address& remoteAddr) {
+/**
+ * Create a socket in a free slot of [ring].
+ */
+static Promise<int> __tryCreateDirectSocket(IoUring& ring) {
+    int slot = ring.allocateFileSlot();
+    if (slot == -1)
+        throw SocketError("Failed to create socket: no free slot in the ring's file table");
+
+    IoUring::CompleteQueueEntry cqe;
+    try {
+        cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+            io_uring_prep_socket_direct(sqe, AF_INET, SOCK_STREAM, 0, slot, 0);
+        });
+    }
+    catch (...) {
+        ring.releaseFileSlot(slot);
+        throw;
+    }
+
+    if (cqe.res < 0) {
+        ring.releaseFileSlot(slot);
+        throw SocketError("Failed to create socket: " + std::string(strerror(-cqe.res)));
+    }
+
+    co_return slot;
+}
+
+
+/**
+ * Throw if [fd] is a direct descriptor of a ring other than [ring].
+ */
+static void __checkRing(const RingFd& fd, IoUring& ring) {
+    if (!fd.usableOn(ring))
+        throw std::logic_error("IoUringInet4StreamSocket: direct descriptor used from another thread");
+}
+
+
+Promise<> IoUringInet4StreamSocket::connectImpl(const Inet4Address& remoteAddr, Timeout timeout, bool direct) {
     close();
-    fd_ = __tryCreateSocket();
+
+    auto& ring = __ring();
+    if (direct) {
+        int slot = co_await __tryCreateDirectSocket(ring);
+        fd_.adoptDirect(ring, slot);
+    }
+    else {
+        fd_ = RingFd(__tryCreateSocket());
+    }
 
     sockaddr_in addr = remoteAddr.toSockAddrIn();
 
-    auto sqe = co_await __ring().getSqe();
-    io_uring_prep_connect(sqe, this->fd_, (sockaddr*) &addr, sizeof(addr));
-    auto res = co_await __ring().submitAndWaitRes(sqe);
+    auto cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+        io_uring_prep_connect(sqe, fd_.fd(), (sockaddr*) &addr, sizeof(addr));
+        fd_.apply(sqe, ring);
+    }, timeout);
+    auto res = cqe.res;
 
     if (res < 0) {
         close();
+        if (res == -ETIMEDOUT)
+            throw TimeoutError("Failed to connect: timed out");
         throw ConnectError("Failed to connect: " + std::string(strerror(-res)));
     }
 
@@ -51,12 +101,13 @@ Promise<> IoUringInet4StreamSocket::connect(const Inet4Address& remoteAddr) {
 
 Promise<> IoUringInet4StreamSocket::bind(const Inet4Address& localAddr) {
     close();
-    fd_ = __tryCreateSocket();
+    fd_ = RingFd(__tryCreateSocket());
 
-    auto sqe = co_await __ring().getSqe();
     sockaddr_in addr = localAddr.toSockAddrIn();
-    io_uring_prep_bind(sqe, this->fd_, (sockaddr*) &addr, sizeof(addr));
-    auto res = co_await __ring().submitAndWaitRes(sqe);
+    auto cqe = co_await __ring().operation([&] (io_uring_sqe* sqe) {
+        io_uring_prep_bind(sqe, fd_.fd(), (sockaddr*) &addr, sizeof(addr));
+    });
+    auto res = cqe.res;
     if (res < 0) {
         close();
         throw BindError("Failed to bind: " + std::string(strerror(-res)));
@@ -66,46 +117,175 @@ Promise<> IoUringInet4StreamSocket::bind(const Inet4Address& localAddr) {
 
 
 void IoUringInet4StreamSocket::close() {
-    if (isValid()) {
-        ::close(fd_);
-        fd_ = -1;
-    }
+    fd_.close();
 }
 
 
-Promise<IoUringInet4StreamSocket> IoUringInet4StreamSocket::accept() {
-    auto sqe = co_await __ring().getSqe();
-    io_uring_prep_accept(sqe, this->fd_, nullptr, nullptr, 0);
-    auto res = co_await __ring().submitAndWaitRes(sqe);
+Promise<IoUringInet4StreamSocket> IoUringInet4StreamSocket::acceptImpl(Timeout timeout, bool direct) {
+    auto& ring = __ring();
+    __checkRing(fd_, ring);
+
+    int slot = -1;
+    if (direct) {
+        slot = ring.allocateFileSlot();
+        if (slot == -1)
+            throw AcceptError("Failed to accept: no free slot in the ring's file table");
+    }
+
+    IoUring::CompleteQueueEntry cqe;
+    try {
+        cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+            if (direct)
+                io_uring_prep_accept_direct(sqe, fd_.fd(), nullptr, nullptr, 0, slot);
+            else
+                io_uring_prep_accept(sqe, fd_.fd(), nullptr, nullptr, 0);
+            fd_.apply(sqe, ring);
+        }, timeout);
+    }
+    catch (...) {
+        if (direct)
+            ring.releaseFileSlot(slot);
+        throw;
+    }
+
+    auto res = cqe.res;
     if (res < 0) {
+        if (direct)
+            ring.releaseFileSlot(slot);
+        if (res == -ETIMEDOUT)
+            throw TimeoutError("Failed to accept: timed out");
         throw AcceptError("Failed to accept: " + std::string(strerror(-res)));
     }
 
-    int clientFd = res;
     IoUringInet4StreamSocket clientSocket;
-    clientSocket.fd_ = clientFd;
-    co_return clientSocket;
+    if (direct)
+        clientSocket.fd_.adoptDirect(ring, slot);
+    else
+        clientSocket.fd_ = RingFd(res);
+    co_return std::move(clientSocket);
 }
 
-Promise<std::size_t> IoUringInet4StreamSocket::readSome(void* buffer, std::size_t size) {
-    auto sqe = co_await __ring().getSqe();
-    io_uring_prep_read(sqe, this->fd_, buffer, size, 0);
-    auto res = co_await __ring().submitAndWaitRes(sqe);
+Promise<IoResult<>> IoUringInet4StreamSocket::tryReadSomeImpl(void* buffer, std::size_t size, Timeout timeout, const BufferPool* pool) {
+    auto& ring = __ring();
+    __checkRing(fd_, ring);
+
+    int bufferIndex = pool ? pool->bufferIndexFor(ring) : -1;
+
+    auto cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+        if (bufferIndex != -1)
+            io_uring_prep_read_fixed(sqe, fd_.fd(), buffer, size, 0, bufferIndex);
+        else
+            io_uring_prep_read(sqe, fd_.fd(), buffer, size, 0);
+        fd_.apply(sqe, ring);
+    }, timeout);
+    auto res = cqe.res;
     if (res < 0) {
-        throw SocketError("Failed to read: " + std::string(strerror(-res)));
+        co_return errnoError(-res);
     }
     co_return res;
 }
 
 
-Promise<std::size_t> IoUringInet4StreamSocket::writeSome(const void* buffer, std::size_t size) {
-    auto sqe = co_await __ring().getSqe();
-    io_uring_prep_write(sqe, this->fd_, buffer, size, 0);
-    auto res = co_await __ring().submitAndWaitRes(sqe);
+Promise<IoResult<>> IoUringInet4StreamSocket::tryWriteSomeImpl(const void* buffer, std::size_t size, Timeout timeout, const BufferPool* pool) {
+    auto& ring = __ring();
+    __checkRing(fd_, ring);
+
+    int bufferIndex = pool ? pool->bufferIndexFor(ring) : -1;
+
+    auto cqe = co_await ring.operation([&] (io_uring_sqe* sqe) {
+        if (bufferIndex != -1)
+            io_uring_prep_write_fixed(sqe, fd_.fd(), buffer, size, 0, bufferIndex);
+        else
+            io_uring_prep_write(sqe, fd_.fd(), buffer, size, 0);
+        fd_.apply(sqe, ring);
+    }, timeout);
+    auto res = cqe.res;
     if (res < 0) {
-        throw SocketError("Failed to write: " + std::string(strerror(-res)));
+        co_return errnoError(-res);
     }
     co_return res;
 }
 
+
+Promise<std::size_t> IoUringInet4StreamSocket::readSome(void* buffer, std::size_t size) {
+    return this->tryReadSome(buffer, size).map([] (IoResult<> res) {
+        if (!res) {
+            throw SocketError("Failed to read: " + res.error().message());
+        }
+        return *res;
+    });
+}
+
+
+Promise<std::size_t> IoUringInet4StreamSocket::writeSome(const void* buffer, std::size_t size) {
+    return this->tryWriteSome(buffer, size).map([] (IoResult<> res) {
+        if (!res) {
+            throw SocketError("Failed to write: " + res.error().message());
+        }
+        return *res;
+    });
+}
+
+
+/**
+ * Throw what `readSome` / `writeSome` with a deadline throw for a failed [res].
+ */
+static void __throwTimedIoError(const IoResult<>& res, const char* what) {
+    if (res.error() == std::errc::timed_out)
+        throw TimeoutError(std::string("Failed to ") + what + ": timed out");
+    throw SocketError(std::string("Failed to ") + what + ": " + res.error().message());
+}
+
+
+Promise<std::size_t> IoUringInet4StreamSocket::readSome(void* buffer, std::size_t size, std::chrono::nanoseconds timeout) {
+    return this->tryReadSomeImpl(buffer, size, timeout).map([] (IoResult<> res) {
+        if (!res)
+            __throwTimedIoError(res, "read");
+        return *res;
+    });
+}
+
+
+Promise<std::size_t> IoUringInet4StreamSocket::writeSome(const void* buffer, std::size_t size, std::chrono::nanoseconds timeout) {
+    return this->tryWriteSomeImpl(buffer, size, timeout).map([] (IoResult<> res) {
+        if (!res)
+            __throwTimedIoError(res, "write");
+        return *res;
+    });
+}
+
+
+Promise<IoResult<>> IoUringInet4StreamSocket::tryReadSome(BufferLease& buffer, std::size_t size) {
+    if (size > buffer.size())
+        return Promise<IoResult<>>::reject(std::length_error("IoUringInet4StreamSocket: reading past the leased buffer"));
+
+    return this->tryReadSomeImpl(buffer.data(), size, std::nullopt, buffer.pool());
+}
+
+
+Promise<IoResult<>> IoUringInet4StreamSocket::tryWriteSome(const BufferLease& buffer, std::size_t size) {
+    if (size > buffer.size())
+        return Promise<IoResult<>>::reject(std::length_error("IoUringInet4StreamSocket: writing past the leased buffer"));
+
+    return this->tryWriteSomeImpl(buffer.data(), size, std::nullopt, buffer.pool());
+}
+
+
+Promise<std::size_t> IoUringInet4StreamSocket::readSome(BufferLease& buffer, std::size_t size) {
+    return this->tryReadSome(buffer, size).map([] (IoResult<> res) {
+        if (!res)
+            __throwTimedIoError(res, "read");
+        return *res;
+    });
+}
+
+
+Promise<std::size_t> IoUringInet4StreamSocket::writeSome(const BufferLease& buffer, std::size_t size) {
+    return this->tryWriteSome(buffer, size).map([] (IoResult<> res) {
+        if (!res)
+            __throwTimedIoError(res, "write");
+        return *res;
+    });
+}
+
 }  // namespace vega::io
@@ -4,8 +4,13 @@
 
 #if defined(__linux__)
 
+#include <chrono>
+#include <optional>
+
 #include <vega/io/net/Inet4StreamSocket.h>
 #include <vega/io/IoUring.h>
+#include <vega/io/RingFd.h>
+#include <vega/io/BufferPool.h>
 
 #include <vega/Promise.h>
 
@@ -13,24 +18,122 @@ namespace vega::io {
 
 class IoUringInet4StreamSocket : public Inet4StreamSocket {
 protected:
-    int fd_ = -1;
+    RingFd fd_;
+
+    using Timeout = std::optional<std::chrono::nanoseconds>;
+
+    /**
+     * @param direct Create the socket as a direct descriptor of this thread's ring.
+     */
+    Promise<> connectImpl(const Inet4Address& remoteAddr, Timeout timeout, bool direct = false);
+    Promise<IoUringInet4StreamSocket> acceptImpl(Timeout timeout, bool direct = false);
+
+    /**
+     * @param pool Pool [buffer] belongs to, to read or write it as a registered buffer.
+     */
+    Promise<IoResult<>> tryReadSomeImpl(void* buffer, std::size_t size, Timeout timeout, const BufferPool* pool = nullptr);
+    Promise<IoResult<>> tryWriteSomeImpl(const void* buffer, std::size_t size, Timeout timeout, const BufferPool* pool = nullptr);
 
 public:
 
+    IoUringInet4StreamSocket() = default;
+
+    IoUringInet4StreamSocket(IoUringInet4StreamSocket&&) = default;
+    IoUringInet4StreamSocket& operator = (IoUringInet4StreamSocket&&) = default;
+
     virtual ~IoUringInet4StreamSocket() { this->close(); }
 
-    virtual Promise<> connect(const Inet4Address& remoteAddr) override;
+    virtual Promise<> connect(const Inet4Address& remoteAddr) override {
+        return connectImpl(remoteAddr, std::nullopt);
+    }
 
     virtual Promise<> bind(const Inet4Address& localAddr) override;
 
-    virtual bool isValid() const override { return fd_ != -1; }
+    virtual bool isValid() const override { return fd_.isValid(); }
 
-    virtual Promise<IoUringInet4StreamSocket> accept();
+    virtual Promise<IoUringInet4StreamSocket> accept() { return acceptImpl(std::nullopt); }
     
     virtual void close() override;
 
     virtual Promise<std::size_t> readSome(void* buffer, std::size_t size) override;
     virtual Promise<std::size_t> writeSome(const void* buffer, std::size_t size) override;
+
+    virtual Promise<IoResult<>> tryReadSome(void* buffer, std::size_t size) override {
+        return tryReadSomeImpl(buffer, size, std::nullopt);
+    }
+
+    virtual Promise<IoResult<>> tryWriteSome(const void* buffer, std::size_t size) override {
+        return tryWriteSomeImpl(buffer, size, std::nullopt);
+    }
+
+
+    /*
+     * Registered files (see `RingFd`). A direct socket has no fd: it only exists in this
+     * thread's ring, and using it from another thread throws std::logic_error.
+     */
+
+    /**
+     * Register the socket with this thread's ring, so operations from this thread
+     * skip the kernel's per-operation file lookup.
+     *
+     * @return False if the ring's file table is full or unsupported. The socket works all the same.
+     */
+    bool registerFd() { return fd_.registerWith(IoUring::getThreadIoUring()); }
+
+    /**
+     * Like `connect`, with the socket created as a direct descriptor (io_uring_prep_socket_direct).
+     */
+    Promise<> connectDirect(const Inet4Address& remoteAddr) {
+        return connectImpl(remoteAddr, std::nullopt, true);
+    }
+
+    /**
+     * Like `accept`, with the connection accepted into a direct descriptor (io_uring_prep_accept_direct).
+     */
+    Promise<IoUringInet4StreamSocket> acceptDirect() { return acceptImpl(std::nullopt, true); }
+
+    /**
+     * The fd, or -1 if the socket is a direct descriptor.
+     */
+    int fd() const { return fd_.fd(); }
+
+
+    /*
+     * Variants reading into and writing from a leased buffer (see `BufferPool`), with
+     * io_uring_prep_read_fixed / write_fixed if the pool is registered with this thread's
+     * ring. [size] is at most the lease's size.
+     */
+
+    Promise<std::size_t> readSome(BufferLease& buffer, std::size_t size);
+    Promise<std::size_t> writeSome(const BufferLease& buffer, std::size_t size);
+    Promise<IoResult<>> tryReadSome(BufferLease& buffer, std::size_t size);
+    Promise<IoResult<>> tryWriteSome(const BufferLease& buffer, std::size_t size);
+
+
+    /*
+     * Variants with a deadline. The kernel aborts the operation once [timeout] passes
+     * (see IoUring::submitAndWait), and it fails with TimeoutError, or std::errc::timed_out
+     * for the try- variants.
+     */
+
+    Promise<> connect(const Inet4Address& remoteAddr, std::chrono::nanoseconds timeout) {
+        return connectImpl(remoteAddr, timeout);
+    }
+
+    Promise<IoUringInet4StreamSocket> accept(std::chrono::nanoseconds timeout) {
+        return acceptImpl(timeout);
+    }
+
+    Promise<std::size_t> readSome(void* buffer, std::size_t size, std::chrono::nanoseconds timeout);
+    Promise<std::size_t> writeSome(const void* buffer, std::size_t size, std::chrono::nanoseconds timeout);
+
+    Promise<IoResult<>> tryReadSome(void* buffer, std::size_t size, std::chrono::nanoseconds timeout) {
+        return tryReadSomeImpl(buffer, size, timeout);
+    }
+
+    Promise<IoResult<>> tryWriteSome(const void* buffer, std::size_t size, std::chrono::nanoseconds timeout) {
+        return tryWriteSomeImpl(buffer, size, timeout);
+    }
 };
 
 
@@ -8,7 +8,9 @@
 
 #include <vector>
 #include <vega/Promise.h>
+#include <vega/AsyncGenerator.h>
 
+#include <vega/io/IoResult.h>
 #include <vega/io/net/Errors.h>
 
 
@@ -26,6 +28,16 @@ public:
     virtual Promise<std::size_t> readSome(void* buffer, std::size_t size) = 0;
     virtual Promise<std::size_t> writeSome(const void* buffer, std::size_t size) = 0;
 
+    /**
+     * Like `readSome`, but failures are returned as error codes instead of thrown.
+     */
+    virtual Promise<IoResult<>> tryReadSome(void* buffer, std::size_t size) = 0;
+
+    /**
+     * Like `writeSome`, but failures are returned as error codes instead of thrown.
+     */
+    virtual Promise<IoResult<>> tryWriteSome(const void* buffer, std::size_t size) = 0;
+
 
     Promise<std::size_t> read(void* buffer, std::size_t size) {
         std::size_t totalRead = 0;
@@ -75,6 +87,33 @@ public:
         return this->writeSome(buf.data(), buf.size());
     }
 
+    Promise<IoResult<>> tryReadSome(std::vector<char>& buf) {
+        return this->tryReadSome(buf.data(), buf.size());
+    }
+
+    Promise<IoResult<>> tryWriteSome(const std::vector<char>& buf) {
+        return this->tryWriteSome(buf.data(), buf.size());
+    }
+
+    /**
+     * Stream incoming data in chunks of at most [chunkSize] bytes, until the peer
+     * closes the connection. Nothing is read until the consumer asks for the next chunk,
+     * so a slow consumer applies backpressure through the socket's receive window.
+     *
+     * The socket must stay open while the generator is in use.
+     */
+    AsyncGenerator<std::vector<char>> readChunks(std::size_t chunkSize) {
+        while (true) {
+            std::vector<char> chunk(chunkSize);
+            auto n = co_await this->readSome(chunk.data(), chunkSize);
+            if (n == 0)
+                co_return;
+
+            chunk.resize(n);
+            co_yield std::move(chunk);
+        }
+    }
+
     operator bool() const { return this->isValid(); } 
 
 
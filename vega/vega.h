@@ -3,6 +3,7 @@
 #pragma once
 
 #include <vega/Promise.h>
+#include <vega/AsyncGenerator.h>
 #include <vega/Scheduler.h>
 
 #include <vega/io/file/File.h>